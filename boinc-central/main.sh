@@ -12,6 +12,44 @@ for arg in "$@"; do
 done
 
 IFS="$DELIMITER" read -ra COMMANDS <<<"$JOINED_ARGS"
+
+# the search binaries run several chunks back to back themselves and write the
+# same sections as the loop below, that saves starting a process and setting
+# up the tables for every chunk, only the builds that take ## chunk lists,
+# e.g. not full-search-plan
+PROGRAM=""
+SAME_PROGRAM=1
+NUM_CHUNKS=0
+CHUNKS=()
+for cmd in "${COMMANDS[@]}"; do
+  read -ra WORDS <<<"$cmd"
+  if [ ${#WORDS[@]} -eq 0 ]; then
+    continue
+  fi
+
+  if [ -z "$PROGRAM" ]; then
+    PROGRAM="${WORDS[0]}"
+  elif [ "$PROGRAM" != "${WORDS[0]}" ]; then
+    SAME_PROGRAM=0
+  fi
+  if [ $NUM_CHUNKS -gt 0 ]; then
+    CHUNKS+=("$DELIMITER")
+  fi
+  CHUNKS+=("${WORDS[@]:1}")
+  NUM_CHUNKS=$((NUM_CHUNKS + 1))
+done
+
+case "$(basename "$PROGRAM")" in
+full-search | full-search-collect | full-search-instrument | \
+  full-search-optimized | full-search-x86_64 | full-search-arm64 | \
+  full-search-macos-arm64 | hungry-search)
+  if [ "$SAME_PROGRAM" = 1 ] && [ $NUM_CHUNKS -gt 1 ]; then
+    $PROGRAM "${CHUNKS[@]}" >>output 2>&1
+    exit
+  fi
+  ;;
+esac
+
 for cmd in "${COMMANDS[@]}"; do
   cmd=$(echo "$cmd" | sed -e 's/^[[:space:]]*//' -e 's/[[:space:]]*$//')
 
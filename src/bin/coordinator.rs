@@ -0,0 +1,347 @@
+//! Serves the chunks of a plan file to full-search and hungry-search workers,
+//! started with `--worker <host>:<port>`, see src/worker.h for the protocol.
+//!
+//!   target/full-search-plan > plan.txt
+//!   coordinator plan.txt results --listen 0.0.0.0:7878
+//!   target/full-search --worker head-node:7878
+//!
+//! or for hungry-search, whose plans have `-c` in front of the indices,
+//!
+//!   coordinator hungry-plan-16-22-2.txt hungry-results
+//!   target/hungry-search --worker 127.0.0.1:7878
+//!
+//! Every chunk is leased to one worker at a time, a lease that isn't answered
+//! with a result within `--lease <secs>` expires and the chunk goes to the
+//! next worker that asks. The result of a chunk is the text the worker printed
+//! for it, not the binary solution records, it's written to
+//! `<results-dir>/chunk-<line>_output`, in the format progress reads, and a
+//! restarted coordinator skips the chunks that already have one. Workers that
+//! ask while the remaining chunks are all leased are told to wait, so they can
+//! pick up the chunks of workers that died. A chunk a worker can't run, e.g.
+//! with the wrong number of indices for its build, fails and isn't leased
+//! again, it gets no result, so a restart tries it again. So does a chunk whose
+//! output is over `--max-output <bytes>`, which isn't read.
+
+use std::collections::HashMap;
+use std::fs;
+use std::io::{self, BufRead, BufReader, Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+/// How long an idle worker waits before it asks again.
+const WAIT_SECS: u64 = 10;
+
+/// How long a request can stall before its connection is dropped.
+const IO_TIMEOUT_SECS: u64 = 60;
+
+enum State {
+    Pending,
+    Leased {
+        lease: u64,
+        worker: String,
+        until: Instant,
+    },
+    Done,
+    Failed,
+}
+
+struct Chunk {
+    line: String,
+    state: State,
+}
+
+struct Coordinator {
+    chunks: Vec<Chunk>,
+    /// the chunk of every lease, also of the expired ones, a late result is
+    /// still taken if no other worker finished the chunk first
+    leases: HashMap<u64, usize>,
+    next_lease: u64,
+    lease_duration: Duration,
+    results_dir: PathBuf,
+    num_done: usize,
+    num_failed: usize,
+}
+
+fn result_path(dir: &Path, index: usize) -> PathBuf {
+    dir.join(format!("chunk-{:06}_output", index))
+}
+
+impl Coordinator {
+    fn expire_leases(&mut self) {
+        let now = Instant::now();
+        for (i, chunk) in self.chunks.iter_mut().enumerate() {
+            if let State::Leased {
+                lease,
+                worker,
+                until,
+            } = &chunk.state
+            {
+                if *until <= now {
+                    eprintln!("lease {} of chunk {} by {} expired", lease, i, worker);
+                    chunk.state = State::Pending;
+                }
+            }
+        }
+    }
+
+    fn lease(&mut self, worker: &str) -> String {
+        self.expire_leases();
+        let Some(index) = self
+            .chunks
+            .iter()
+            .position(|c| matches!(c.state, State::Pending))
+        else {
+            return if self.num_done + self.num_failed == self.chunks.len() {
+                "DONE\n".to_string()
+            } else {
+                format!("WAIT {}\n", WAIT_SECS)
+            };
+        };
+
+        let lease = self.next_lease;
+        self.next_lease += 1;
+        self.leases.insert(lease, index);
+        let chunk = &mut self.chunks[index];
+        chunk.state = State::Leased {
+            lease,
+            worker: worker.to_string(),
+            until: Instant::now() + self.lease_duration,
+        };
+        eprintln!(
+            "lease {} of chunk {} to {}: {}",
+            lease, index, worker, chunk.line
+        );
+        format!("CHUNK {} {}\n", lease, chunk.line)
+    }
+
+    fn result(&mut self, lease: u64, data: &[u8]) -> io::Result<String> {
+        let Some(&index) = self.leases.get(&lease) else {
+            return Ok("STALE unknown lease\n".to_string());
+        };
+        if matches!(self.chunks[index].state, State::Done) {
+            return Ok("STALE chunk is already done\n".to_string());
+        }
+
+        // written next to it and renamed, so a result file is always complete
+        let path = result_path(&self.results_dir, index);
+        let tmp_path = path.with_extension("tmp");
+        fs::write(&tmp_path, data)?;
+        fs::rename(&tmp_path, &path)?;
+
+        self.chunks[index].state = State::Done;
+        self.num_done += 1;
+        eprintln!(
+            "chunk {} done with lease {}, {}/{}",
+            index,
+            lease,
+            self.num_done,
+            self.chunks.len()
+        );
+        self.report_finished();
+        Ok("OK\n".to_string())
+    }
+
+    fn report_finished(&self) {
+        if self.num_done + self.num_failed < self.chunks.len() {
+            return;
+        }
+        if self.num_failed == 0 {
+            eprintln!("all chunks done");
+        } else {
+            eprintln!(
+                "all chunks done, {} of them failed and have no result",
+                self.num_failed
+            );
+        }
+    }
+
+    fn release(&mut self, lease: u64) -> String {
+        let Some(&index) = self.leases.get(&lease) else {
+            return "STALE unknown lease\n".to_string();
+        };
+        let chunk = &mut self.chunks[index];
+        match chunk.state {
+            State::Leased { lease: current, .. } if current == lease => {
+                eprintln!("lease {} of chunk {} released", lease, index);
+                chunk.state = State::Pending;
+                "OK\n".to_string()
+            }
+            _ => "STALE lease is not current\n".to_string(),
+        }
+    }
+
+    fn fail(&mut self, lease: u64, reason: &str) -> String {
+        let Some(&index) = self.leases.get(&lease) else {
+            return "STALE unknown lease\n".to_string();
+        };
+        let chunk = &mut self.chunks[index];
+        match chunk.state {
+            State::Leased { lease: current, .. } if current == lease => {
+                eprintln!(
+                    "chunk {} failed with lease {}: {}: {}",
+                    index, lease, reason, chunk.line
+                );
+                chunk.state = State::Failed;
+                self.num_failed += 1;
+                self.report_finished();
+                "OK\n".to_string()
+            }
+            _ => "STALE lease is not current\n".to_string(),
+        }
+    }
+}
+
+fn handle(
+    stream: TcpStream,
+    coordinator: &Mutex<Coordinator>,
+    max_output: usize,
+) -> io::Result<()> {
+    stream.set_read_timeout(Some(Duration::from_secs(IO_TIMEOUT_SECS)))?;
+    stream.set_write_timeout(Some(Duration::from_secs(IO_TIMEOUT_SECS)))?;
+    let mut reader = BufReader::new(stream.try_clone()?);
+    let mut header = String::new();
+    (&mut reader).take(4096).read_line(&mut header)?;
+    let words: Vec<&str> = header.split_whitespace().collect();
+
+    let reply = match words.as_slice() {
+        ["LEASE", worker] => coordinator.lock().unwrap().lease(worker),
+        ["RESULT", lease, size] => {
+            let (Ok(lease), Ok(size)) = (lease.parse::<u64>(), size.parse::<usize>()) else {
+                return Err(io::Error::new(io::ErrorKind::InvalidData, header));
+            };
+            if size > max_output {
+                let reason = format!("output of {} bytes is over --max-output", size);
+                coordinator.lock().unwrap().fail(lease, &reason);
+                format!("FAILED {}\n", reason)
+            } else {
+                // read before taking the lock, the output can be large
+                let mut data = vec![0; size];
+                reader.read_exact(&mut data)?;
+                coordinator.lock().unwrap().result(lease, &data)?
+            }
+        }
+        ["RELEASE", lease] => match lease.parse::<u64>() {
+            Ok(lease) => coordinator.lock().unwrap().release(lease),
+            Err(_) => return Err(io::Error::new(io::ErrorKind::InvalidData, header)),
+        },
+        ["FAIL", lease, reason @ ..] => match lease.parse::<u64>() {
+            Ok(lease) => coordinator.lock().unwrap().fail(lease, &reason.join(" ")),
+            Err(_) => return Err(io::Error::new(io::ErrorKind::InvalidData, header)),
+        },
+        _ => return Err(io::Error::new(io::ErrorKind::InvalidData, header)),
+    };
+
+    let mut stream = stream;
+    stream.write_all(reply.as_bytes())
+}
+
+fn usage() -> ! {
+    eprintln!(
+        "Usage: coordinator <plan-file> <results-dir> [--listen <addr:port>] [--lease <secs>] \
+         [--max-output <bytes>]"
+    );
+    std::process::exit(1);
+}
+
+fn main() {
+    let mut args = std::env::args().skip(1);
+    let mut positional: Vec<String> = Vec::new();
+    let mut listen = "127.0.0.1:7878".to_string();
+    let mut lease_secs: u64 = 4 * 3600;
+    let mut max_output: usize = 1 << 30;
+
+    while let Some(arg) = args.next() {
+        let mut value = || {
+            args.next().unwrap_or_else(|| {
+                eprintln!("{} requires an argument", arg);
+                std::process::exit(1);
+            })
+        };
+        match arg.as_str() {
+            "--listen" => listen = value(),
+            "--lease" => lease_secs = value().parse().unwrap_or_else(|_| usage()),
+            "--max-output" => max_output = value().parse().unwrap_or_else(|_| usage()),
+            _ if !arg.starts_with("--") => positional.push(arg),
+            _ => {
+                eprintln!("Unknown argument: {}", arg);
+                usage();
+            }
+        }
+    }
+    let [plan_path, results_dir] = positional.as_slice() else {
+        usage();
+    };
+
+    let plan = fs::read_to_string(plan_path).unwrap_or_else(|e| {
+        eprintln!("Failed to read {}: {}", plan_path, e);
+        std::process::exit(1);
+    });
+    let results_dir = PathBuf::from(results_dir);
+    fs::create_dir_all(&results_dir).unwrap_or_else(|e| {
+        eprintln!("Failed to create {}: {}", results_dir.display(), e);
+        std::process::exit(1);
+    });
+
+    let chunks: Vec<Chunk> = plan
+        .lines()
+        .map(str::trim)
+        .filter(|line| !line.is_empty())
+        .enumerate()
+        .map(|(i, line)| Chunk {
+            line: line.to_string(),
+            state: if result_path(&results_dir, i).exists() {
+                State::Done
+            } else {
+                State::Pending
+            },
+        })
+        .collect();
+    let num_done = chunks
+        .iter()
+        .filter(|c| matches!(c.state, State::Done))
+        .count();
+    eprintln!(
+        "{} chunks, {} already done, listening on {}",
+        chunks.len(),
+        num_done,
+        listen
+    );
+
+    let coordinator = Arc::new(Mutex::new(Coordinator {
+        chunks,
+        leases: HashMap::new(),
+        // from the clock, so a worker's lease from before a restart can't
+        // name another chunk
+        next_lease: SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .map(|d| d.as_secs() * 1000)
+            .unwrap_or(1),
+        lease_duration: Duration::from_secs(lease_secs),
+        results_dir,
+        num_done,
+        num_failed: 0,
+    }));
+
+    let listener = TcpListener::bind(&listen).unwrap_or_else(|e| {
+        eprintln!("Failed to listen on {}: {}", listen, e);
+        std::process::exit(1);
+    });
+    for stream in listener.incoming() {
+        let Ok(stream) = stream else {
+            continue;
+        };
+        let coordinator = Arc::clone(&coordinator);
+        thread::spawn(move || {
+            let peer = stream
+                .peer_addr()
+                .map(|a| a.to_string())
+                .unwrap_or_default();
+            if let Err(e) = handle(stream, &coordinator, max_output) {
+                eprintln!("Request from {} failed: {}", peer, e);
+            }
+        });
+    }
+}
@@ -1,4 +1,9 @@
 use phf::{phf_set, Set};
+use rusqlite::Connection;
+use std::cmp::Ordering;
+use std::collections::{BinaryHeap, HashMap, HashSet};
+use std::fs;
+use std::io::{self, Write};
 
 pub static JOBS_TO_IGNORE: Set<&'static str> = phf_set! {
     // Mark6stark
@@ -452,3 +457,207 @@ pub static JOBS_TO_IGNORE: Set<&'static str> = phf_set! {
     "batch_2026__job_job-000745",
     "batch_2022__job_job-000229",
 };
+
+/// Options of the `requeue` subcommand.
+pub struct RequeueOptions {
+    /// Predicted runtime of one job in seconds.
+    pub target_secs: f64,
+    /// Executable each chunk is run with, e.g. `full-search`.
+    pub command: String,
+    /// Job file to write, one job per line.
+    pub out: String,
+}
+
+/// Chunks of files that don't have a single verified chunk yet, as
+/// (file_id, chunk_id, secs) rows.
+fn unverified_file_chunks(conn: &Connection) -> Vec<(i64, String, f64)> {
+    let mut stmt = conn
+        .prepare(
+            "SELECT c.file_id, c.chunk_id, c.secs
+             FROM chunks c
+             WHERE c.ignore = 0
+               AND c.corrupt = 0
+               AND c.file_id IN (
+                   SELECT f.id FROM files f
+                   WHERE f.ignore = 0
+                     AND f.corrupt = 0
+                     AND NOT EXISTS (
+                         SELECT 1 FROM chunks c2
+                         WHERE c2.file_id = f.id
+                           AND c2.verified = 1
+                     )
+               )",
+        )
+        .expect("Failed to prepare unverified chunks query");
+    stmt.query_map([], |r| Ok((r.get(0)?, r.get(1)?, r.get(2)?)))
+        .expect("Failed to query unverified chunks")
+        .filter_map(Result::ok)
+        .collect()
+}
+
+/// Picks the chunks to re-run so that every unverified file gets a second
+/// result for at least one of its chunks. A chunk that appears in several
+/// unverified files covers all of them with one run, so this is a greedy
+/// weighted set cover: the chunk with the most uncovered files per predicted
+/// second goes first. Scores only drop as files get covered, so the heap is
+/// re-scored lazily, an entry whose count is stale is pushed again with the
+/// current one, and a pick only touches the chunks of the files it covers.
+/// Returns (chunk_id, predicted secs) pairs.
+fn pick_chunks(rows: &[(i64, String, f64)]) -> Vec<(String, f64)> {
+    // chunk_id -> (files it appears in, sum of secs, number of runs)
+    let mut candidates: HashMap<&str, (Vec<i64>, f64, u32)> = HashMap::new();
+    for (file_id, chunk_id, secs) in rows {
+        let entry = candidates.entry(chunk_id).or_default();
+        entry.0.push(*file_id);
+        entry.1 += secs;
+        entry.2 += 1;
+    }
+
+    let mut candidates: Vec<(&str, Vec<i64>, f64)> = candidates
+        .into_iter()
+        .map(|(chunk_id, (mut files, secs, runs))| {
+            files.sort_unstable();
+            files.dedup();
+            (chunk_id, files, secs / runs as f64)
+        })
+        .collect();
+    // deterministic output for identical databases
+    candidates.sort_by(|a, b| a.0.cmp(b.0));
+
+    // file_id -> the candidates it appears in, None once it's covered
+    let mut file_chunks: HashMap<i64, Option<Vec<usize>>> = HashMap::new();
+    for (i, (_, files, _)) in candidates.iter().enumerate() {
+        for f in files {
+            file_chunks
+                .entry(*f)
+                .or_insert_with(|| Some(Vec::new()))
+                .as_mut()
+                .unwrap()
+                .push(i);
+        }
+    }
+    let mut num_uncovered: Vec<usize> = candidates.iter().map(|c| c.1.len()).collect();
+
+    let score = |covered: usize, secs: f64| covered as f64 / secs.max(1.0);
+    let mut heap: BinaryHeap<HeapEntry> = candidates
+        .iter()
+        .enumerate()
+        .map(|(i, (_, files, secs))| HeapEntry {
+            score: score(files.len(), *secs),
+            covered: files.len(),
+            index: i,
+        })
+        .collect();
+
+    let mut picked = Vec::new();
+    while let Some(entry) = heap.pop() {
+        let (chunk_id, files, secs) = &candidates[entry.index];
+        let covered = num_uncovered[entry.index];
+        if covered == 0 {
+            continue;
+        }
+        if covered != entry.covered {
+            heap.push(HeapEntry {
+                score: score(covered, *secs),
+                covered,
+                index: entry.index,
+            });
+            continue;
+        }
+
+        for f in files {
+            if let Some(chunks) = file_chunks.get_mut(f).and_then(Option::take) {
+                for c in chunks {
+                    num_uncovered[c] -= 1;
+                }
+            }
+        }
+        picked.push((chunk_id.to_string(), *secs));
+    }
+
+    picked
+}
+
+/// A candidate of `pick_chunks` with its score when it was pushed, the
+/// highest score first, ties go to the first chunk_id.
+struct HeapEntry {
+    score: f64,
+    covered: usize,
+    index: usize,
+}
+
+impl Ord for HeapEntry {
+    fn cmp(&self, other: &Self) -> Ordering {
+        self.score
+            .total_cmp(&other.score)
+            .then_with(|| other.index.cmp(&self.index))
+    }
+}
+
+impl PartialOrd for HeapEntry {
+    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl PartialEq for HeapEntry {
+    fn eq(&self, other: &Self) -> bool {
+        self.cmp(other) == Ordering::Equal
+    }
+}
+
+impl Eq for HeapEntry {}
+
+/// First-fit decreasing packing of chunks into jobs of at most `target_secs`
+/// predicted runtime. Chunks that exceed the target get a job of their own.
+fn pack_jobs(mut chunks: Vec<(String, f64)>, target_secs: f64) -> Vec<(Vec<String>, f64)> {
+    chunks.sort_by(|a, b| b.1.total_cmp(&a.1).then_with(|| a.0.cmp(&b.0)));
+
+    let mut jobs: Vec<(Vec<String>, f64)> = Vec::new();
+    for (chunk_id, secs) in chunks {
+        match jobs.iter_mut().find(|(_, t)| t + secs <= target_secs) {
+            Some((job, t)) => {
+                job.push(chunk_id);
+                *t += secs;
+            }
+            None => jobs.push((vec![chunk_id], secs)),
+        }
+    }
+
+    jobs
+}
+
+/// Writes the jobs that re-run one chunk of every unverified file, in the
+/// format boinc-central/main.sh takes as arguments: the commands of a job
+/// separated by `##`, one job per line.
+pub fn requeue(conn: &Connection, options: &RequeueOptions) -> io::Result<()> {
+    let rows = unverified_file_chunks(conn);
+    let num_files = rows.iter().map(|r| r.0).collect::<HashSet<_>>().len();
+
+    let picked = pick_chunks(&rows);
+    let num_chunks = picked.len();
+    let total_secs: f64 = picked.iter().map(|c| c.1).sum();
+
+    let jobs = pack_jobs(picked, options.target_secs);
+
+    let mut out = io::BufWriter::new(fs::File::create(&options.out)?);
+    for (job, _) in &jobs {
+        let commands: Vec<String> = job
+            .iter()
+            .map(|chunk_id| format!("{} {}", options.command, chunk_id))
+            .collect();
+        writeln!(out, "{}", commands.join(" ## "))?;
+    }
+    out.flush()?;
+
+    println!("unverified files: {}", num_files);
+    println!("chunks to re-run: {}", num_chunks);
+    println!(
+        "jobs written:     {} to {} ({:.0} secs predicted in total)",
+        jobs.len(),
+        options.out,
+        total_secs
+    );
+
+    Ok(())
+}
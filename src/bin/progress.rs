@@ -1,11 +1,13 @@
 use indicatif::{ProgressBar, ProgressStyle};
+use memmap2::Mmap;
 use rayon::prelude::*;
 use rusqlite::{params, Connection};
-use std::collections::{HashMap, HashSet};
+use std::collections::HashMap;
 use std::fs;
-use std::io::{self, BufRead};
 use std::path::{Path, PathBuf};
-use std::sync::Mutex;
+use std::sync::mpsc;
+use std::thread;
+use std::time::UNIX_EPOCH;
 use walkdir::WalkDir;
 
 mod jobs;
@@ -37,6 +39,54 @@ struct Stats {
     matrix: HashMap<u32, MatrixRow>,
 }
 
+impl Stats {
+    fn merge(&mut self, other: &Stats) {
+        self.total_chains += other.total_chains;
+        self.total_secs += other.total_secs;
+        for (k, row_b) in other.matrix.iter() {
+            self.matrix
+                .entry(*k)
+                .and_modify(|row_a| row_a.merge(row_b))
+                .or_insert_with(|| row_b.clone());
+        }
+    }
+}
+
+/// Size and modification time of an output file, used to detect files that
+/// changed since they were ingested.
+#[derive(Clone, Copy, PartialEq)]
+struct FileMeta {
+    size: i64,
+    mtime: i64,
+}
+
+impl FileMeta {
+    fn of(metadata: &fs::Metadata) -> FileMeta {
+        let mtime = metadata
+            .modified()
+            .ok()
+            .and_then(|t| t.duration_since(UNIX_EPOCH).ok())
+            .map(|d| d.as_nanos() as i64)
+            .unwrap_or(0);
+        FileMeta {
+            size: metadata.len() as i64,
+            mtime,
+        }
+    }
+}
+
+/// A parsed output file on its way from the parser threads to the writer.
+struct ScannedFile {
+    db_path: String,
+    meta: FileMeta,
+    // files.id of a previous, now outdated ingestion of the same path
+    replaces: Option<i64>,
+    parsed: Vec<ParsedChunk>,
+    corrupt: bool,
+    ignore: bool,
+    stats: Stats,
+}
+
 struct ParsedChunk {
     chunk_id: String,
     total_chains: u64,
@@ -116,157 +166,176 @@ fn finalize_chunk(chunk: &Chunk, stats: &mut Stats, parsed: &mut Vec<ParsedChunk
 }
 
 fn process_file(path: &Path) -> (Stats, Vec<ParsedChunk>, bool) {
+    let file = match fs::File::open(path) {
+        Ok(file) => file,
+        Err(_) => return (Stats::default(), Vec::new(), false),
+    };
+    let empty = file.metadata().map(|m| m.len() == 0).unwrap_or(true);
+    if empty {
+        return parse_output(path, &[]);
+    }
+
+    // the outputs are only read once, so map them instead of copying them
+    // through a buffered reader
+    match unsafe { Mmap::map(&file) } {
+        Ok(data) => parse_output(path, &data),
+        Err(e) => {
+            eprintln!("Failed to map {}: {}", path.display(), e);
+            (Stats::default(), Vec::new(), false)
+        }
+    }
+}
+
+fn parse_output(path: &Path, data: &[u8]) -> (Stats, Vec<ParsedChunk>, bool) {
     let mut stats = Stats::default();
     let mut parsed: Vec<ParsedChunk> = Vec::new();
     let mut current = Chunk::default();
     let mut file_has_corrupt = false;
 
-    if let Ok(file) = fs::File::open(path) {
-        let reader = io::BufReader::new(file);
-
-        for line in reader.lines().flatten() {
-            let line_trim = line.trim_end();
+    for line in data.split(|&b| b == b'\n') {
+        let line_trim = match std::str::from_utf8(line) {
+            Ok(line) => line.trim_end(),
+            Err(_) => continue,
+        };
 
-            if line_trim.starts_with("x1 = ") {
-                if let Some(fname) = path.file_name().and_then(|n| n.to_str()) {
-                    println!("{}:\n{}", fname, line_trim);
-                }
-            } else if line_trim.contains("Running command:") {
-                if current.corrupt {
-                    file_has_corrupt = true;
-                }
-                if current.total_chains.is_some()
-                    && current.total_chains.unwrap() > 0
-                    && current.real_seen
-                {
-                    finalize_chunk(&current, &mut stats, &mut parsed);
-                }
-                current = Chunk::default();
-
-                let rest = line_trim
-                    .split_once("Running command:")
-                    .map(|(_, after)| after.trim())
-                    .unwrap_or("");
-                if !rest.is_empty() {
-                    let mut tokens = rest.split_whitespace();
-                    let _exe = tokens.next();
-                    let args_vec: Vec<&str> = tokens.collect();
-                    if !args_vec.is_empty() {
-                        current.args = Some(args_vec.join(" "));
-                        current.chunk_id = args_vec
-                            .iter()
-                            .filter_map(|s| s.parse::<u64>().ok())
-                            .collect();
-                    } else {
-                        current.args = Some(String::new());
-                    }
-                }
-            } else if line_trim.starts_with("total chains") {
-                current.in_progress = false;
-                if let Some(tok) = line_trim.split_whitespace().last() {
-                    if tok == "18446744073709551615" {
-                        current.ignore = true;
-                    } else if let Ok(val) = tok.parse::<u64>() {
-                        current.total_chains = Some(val);
-                    }
-                }
-            } else if line_trim.starts_with("user") {
-                if let Some(field) = line_trim.split_whitespace().nth(1) {
-                    current.user_secs = parse_time(field);
+        if line_trim.starts_with("x1 = ") {
+            if let Some(fname) = path.file_name().and_then(|n| n.to_str()) {
+                println!("{}:\n{}", fname, line_trim);
+            }
+        } else if line_trim.contains("Running command:") {
+            if current.corrupt {
+                file_has_corrupt = true;
+            }
+            if current.total_chains.is_some()
+                && current.total_chains.unwrap() > 0
+                && current.real_seen
+            {
+                finalize_chunk(&current, &mut stats, &mut parsed);
+            }
+            current = Chunk::default();
+
+            let rest = line_trim
+                .split_once("Running command:")
+                .map(|(_, after)| after.trim())
+                .unwrap_or("");
+            if !rest.is_empty() {
+                let mut tokens = rest.split_whitespace();
+                let _exe = tokens.next();
+                let args_vec: Vec<&str> = tokens.collect();
+                if !args_vec.is_empty() {
+                    current.args = Some(args_vec.join(" "));
+                    current.chunk_id = args_vec
+                        .iter()
+                        .filter_map(|s| s.parse::<u64>().ok())
+                        .collect();
+                } else {
+                    current.args = Some(String::new());
                 }
-            } else if line_trim.starts_with("real") {
-                if let Some(field) = line_trim.split_whitespace().nth(1) {
-                    if let Some(real) = parse_time(field) {
-                        current.real_secs = Some(real);
-                        current.real_seen = true;
-                    }
+            }
+        } else if line_trim.starts_with("total chains") {
+            current.in_progress = false;
+            if let Some(tok) = line_trim.split_whitespace().last() {
+                if tok == "18446744073709551615" {
+                    current.ignore = true;
+                } else if let Ok(val) = tok.parse::<u64>() {
+                    current.total_chains = Some(val);
                 }
-            } else if line_trim.starts_with("new expressions at chain length:") {
-                current.in_progress = false;
-                current.in_matrix = true;
-            } else if current.in_matrix {
-                if line_trim.is_empty() || line_trim.starts_with("---") {
-                    current.in_matrix = false;
-                    continue;
+            }
+        } else if line_trim.starts_with("user") {
+            if let Some(field) = line_trim.split_whitespace().nth(1) {
+                current.user_secs = parse_time(field);
+            }
+        } else if line_trim.starts_with("real") {
+            if let Some(field) = line_trim.split_whitespace().nth(1) {
+                if let Some(real) = parse_time(field) {
+                    current.real_secs = Some(real);
+                    current.real_seen = true;
                 }
+            }
+        } else if line_trim.starts_with("new expressions at chain length:") {
+            current.in_progress = false;
+            current.in_matrix = true;
+        } else if current.in_matrix {
+            if line_trim.is_empty() || line_trim.starts_with("---") {
+                current.in_matrix = false;
+                continue;
+            }
 
-                if let Some(colon_idx) = line_trim.find(':') {
-                    let n_id_str = line_trim[..colon_idx].trim();
-                    if let Ok(n_id) = n_id_str.parse::<u32>() {
-                        let rest = line_trim[colon_idx + 1..].trim();
-                        let cols: Vec<&str> = rest.split_whitespace().collect();
-                        if cols.len() == 5 {
-                            if let (Ok(n), Ok(sum), Ok(_avg), Ok(min), Ok(max)) = (
-                                cols[0].parse::<u64>(),
-                                cols[1].parse::<u64>(),
-                                cols[2].parse::<f64>(),
-                                cols[3].parse::<u64>(),
-                                cols[4].parse::<u64>(),
-                            ) {
-                                let row = MatrixRow { n, sum, min, max };
-                                current.matrix.insert(n_id, row);
-                            }
+            if let Some(colon_idx) = line_trim.find(':') {
+                let n_id_str = line_trim[..colon_idx].trim();
+                if let Ok(n_id) = n_id_str.parse::<u32>() {
+                    let rest = line_trim[colon_idx + 1..].trim();
+                    let cols: Vec<&str> = rest.split_whitespace().collect();
+                    if cols.len() == 5 {
+                        if let (Ok(n), Ok(sum), Ok(_avg), Ok(min), Ok(max)) = (
+                            cols[0].parse::<u64>(),
+                            cols[1].parse::<u64>(),
+                            cols[2].parse::<f64>(),
+                            cols[3].parse::<u64>(),
+                            cols[4].parse::<u64>(),
+                        ) {
+                            let row = MatrixRow { n, sum, min, max };
+                            current.matrix.insert(n_id, row);
                         }
                     }
                 }
-            } else if current.in_progress {
-                if let Some(space_idx) = line_trim.rfind(' ') {
-                    let tuple_part = &line_trim[..space_idx];
-                    let numbers: Vec<u64> = tuple_part
-                        .split(',')
-                        .map(|s| s.trim())
-                        .filter_map(|s| s.parse::<u64>().ok())
-                        .collect();
-
-                    if numbers.len() >= current.chunk_id.len() + 1 {
-                        let prefix_matches =
-                            numbers[..current.chunk_id.len()] == current.chunk_id[..];
-
-                        if prefix_matches {
-                            let mut valid_tuple = true;
-                            for i in 1..numbers.len() {
-                                if numbers[i] <= numbers[i - 1] {
-                                    valid_tuple = false;
-                                    break;
-                                }
+            }
+        } else if current.in_progress {
+            if let Some(space_idx) = line_trim.rfind(' ') {
+                let tuple_part = &line_trim[..space_idx];
+                let numbers: Vec<u64> = tuple_part
+                    .split(',')
+                    .map(|s| s.trim())
+                    .filter_map(|s| s.parse::<u64>().ok())
+                    .collect();
+
+                if numbers.len() >= current.chunk_id.len() + 1 {
+                    let prefix_matches = numbers[..current.chunk_id.len()] == current.chunk_id[..];
+
+                    if prefix_matches {
+                        let mut valid_tuple = true;
+                        for i in 1..numbers.len() {
+                            if numbers[i] <= numbers[i - 1] {
+                                valid_tuple = false;
+                                break;
                             }
+                        }
 
-                            if valid_tuple {
-                                if !current.last_tuple.is_empty() && numbers <= current.last_tuple {
-                                    current.corrupt = true;
-                                }
-                                current.last_tuple = numbers;
-                            } else {
+                        if valid_tuple {
+                            if !current.last_tuple.is_empty() && numbers <= current.last_tuple {
                                 current.corrupt = true;
                             }
+                            current.last_tuple = numbers;
                         } else {
                             current.corrupt = true;
                         }
+                    } else {
+                        current.corrupt = true;
                     }
                 }
-            } else if line_trim.starts_with("---") {
-                if current.args.is_some() && !current.in_progress {
-                    if current.real_seen {
-                        // Closing separator — all time lines parsed, finalize.
-                        if current.corrupt {
-                            file_has_corrupt = true;
-                        }
-                        if current.total_chains.is_some() && current.total_chains.unwrap() > 0 {
-                            finalize_chunk(&current, &mut stats, &mut parsed);
-                        }
-                        current = Chunk::default();
-                    } else {
-                        // Opening separator — enter progress section.
-                        current.in_progress = true;
-                        current.last_tuple.clear();
+            }
+        } else if line_trim.starts_with("---") {
+            if current.args.is_some() && !current.in_progress {
+                if current.real_seen {
+                    // Closing separator — all time lines parsed, finalize.
+                    if current.corrupt {
+                        file_has_corrupt = true;
                     }
+                    if current.total_chains.is_some() && current.total_chains.unwrap() > 0 {
+                        finalize_chunk(&current, &mut stats, &mut parsed);
+                    }
+                    current = Chunk::default();
+                } else {
+                    // Opening separator — enter progress section.
+                    current.in_progress = true;
+                    current.last_tuple.clear();
                 }
             }
         }
+    }
 
-        if current.corrupt {
-            file_has_corrupt = true;
-        }
+    if current.corrupt {
+        file_has_corrupt = true;
     }
 
     (stats, parsed, file_has_corrupt)
@@ -286,7 +355,9 @@ fn open_db(path: &str) -> Connection {
             id      INTEGER PRIMARY KEY,
             path    TEXT NOT NULL UNIQUE,
             corrupt INTEGER NOT NULL DEFAULT 0,
-            ignore  INTEGER NOT NULL DEFAULT 0
+            ignore  INTEGER NOT NULL DEFAULT 0,
+            size    INTEGER,
+            mtime   INTEGER
         );
 
         CREATE INDEX IF NOT EXISTS files_ignore_corrupt_idx ON files(ignore, corrupt);
@@ -330,17 +401,224 @@ fn open_db(path: &str) -> Connection {
         eprintln!("Failed to create schema: {}", e);
         std::process::exit(1);
     });
+
+    // databases created before files were fingerprinted lack these columns
+    for column in ["size", "mtime"] {
+        let exists: bool = conn
+            .query_row(
+                "SELECT COUNT(*) > 0 FROM pragma_table_info('files') WHERE name = ?1",
+                params![column],
+                |r| r.get(0),
+            )
+            .unwrap_or(false);
+        if !exists {
+            conn.execute_batch(&format!("ALTER TABLE files ADD COLUMN {} INTEGER", column))
+                .unwrap_or_else(|e| {
+                    eprintln!("Failed to add column files.{}: {}", column, e);
+                    std::process::exit(1);
+                });
+        }
+    }
+
     conn
 }
 
-fn write_batch_to_db(conn: &Connection, batch: &[(String, Vec<ParsedChunk>, bool, bool)]) {
-    let mut file_stmt = conn
-        .prepare_cached("INSERT OR IGNORE INTO files (path, corrupt, ignore) VALUES (?1, ?2, ?3)")
-        .expect("Failed to prepare file insert");
+/// Valid (neither ignored nor corrupt) results of one chunk that agree on
+/// total_chains, and how many of them are currently flagged.
+struct ResultGroup {
+    total_chains: i64,
+    runs: i64,
+    verified: i64,
+    wrong: i64,
+}
 
-    let mut file_id_stmt = conn
-        .prepare_cached("SELECT id FROM files WHERE path = ?1")
-        .expect("Failed to prepare file id query");
+/// All valid chunk results grouped by chunk_id, kept in memory so that the
+/// verified and wrong flags can be set without the correlated UPDATE ... EXISTS
+/// queries. It's loaded once before a scan and kept up to date by the writer.
+#[derive(Default)]
+struct VerificationCache {
+    chunks: HashMap<String, Vec<ResultGroup>>,
+}
+
+impl VerificationCache {
+    fn load(conn: &Connection) -> VerificationCache {
+        let mut cache = VerificationCache::default();
+        let mut stmt = conn
+            .prepare(
+                "SELECT chunk_id, total_chains, COUNT(*), SUM(verified), SUM(wrong)
+                 FROM chunks
+                 WHERE ignore = 0 AND corrupt = 0
+                 GROUP BY chunk_id, total_chains",
+            )
+            .expect("Failed to prepare verification query");
+        let rows = stmt
+            .query_map([], |r| {
+                Ok((
+                    r.get::<_, String>(0)?,
+                    r.get::<_, i64>(1)?,
+                    r.get::<_, i64>(2)?,
+                    r.get::<_, i64>(3)?,
+                    r.get::<_, i64>(4)?,
+                ))
+            })
+            .expect("Failed to query chunk results");
+        for (chunk_id, total_chains, runs, verified, wrong) in rows.filter_map(Result::ok) {
+            cache.add(&chunk_id, total_chains, runs, verified, wrong);
+        }
+        cache
+    }
+
+    /// Adds (or with negative counts removes) results of a chunk.
+    fn add(&mut self, chunk_id: &str, total_chains: i64, runs: i64, verified: i64, wrong: i64) {
+        let groups = match self.chunks.get_mut(chunk_id) {
+            Some(groups) => groups,
+            None => self.chunks.entry(chunk_id.to_string()).or_default(),
+        };
+        match groups.iter().position(|g| g.total_chains == total_chains) {
+            Some(i) => {
+                groups[i].runs += runs;
+                groups[i].verified += verified;
+                groups[i].wrong += wrong;
+                if groups[i].runs <= 0 {
+                    groups.swap_remove(i);
+                }
+            }
+            None if runs > 0 => groups.push(ResultGroup {
+                total_chains,
+                runs,
+                verified,
+                wrong,
+            }),
+            None => {}
+        }
+    }
+
+    /// Sets the same flags as the verified and wrong queries in README.org:
+    /// results that are matched by another run are verified, unverified results
+    /// of a chunk that has a verified result with a different total_chains are
+    /// wrong. Flags are only ever set, never cleared. Returns the number of
+    /// updated result groups.
+    fn apply(&mut self, conn: &Connection) -> usize {
+        let mut verify_stmt = conn
+            .prepare_cached(
+                "UPDATE chunks SET verified = 1
+                 WHERE ignore = 0 AND corrupt = 0 AND chunk_id = ?1 AND total_chains = ?2
+                   AND verified = 0",
+            )
+            .expect("Failed to prepare verified update");
+        let mut wrong_stmt = conn
+            .prepare_cached(
+                "UPDATE chunks SET wrong = 1
+                 WHERE ignore = 0 AND corrupt = 0 AND chunk_id = ?1 AND total_chains = ?2
+                   AND verified = 0",
+            )
+            .expect("Failed to prepare wrong update");
+
+        let mut updated = 0;
+        for (chunk_id, groups) in self.chunks.iter_mut() {
+            for g in groups.iter_mut() {
+                if g.runs >= 2 && g.verified < g.runs {
+                    verify_stmt
+                        .execute(params![chunk_id, g.total_chains])
+                        .expect("Failed to set verified flag");
+                    g.verified = g.runs;
+                    updated += 1;
+                }
+            }
+
+            for i in 0..groups.len() {
+                let other_verified = groups
+                    .iter()
+                    .enumerate()
+                    .any(|(j, h)| j != i && h.verified > 0);
+                let g = &mut groups[i];
+                if other_verified && g.verified < g.runs && g.wrong < g.runs - g.verified {
+                    wrong_stmt
+                        .execute(params![chunk_id, g.total_chains])
+                        .expect("Failed to set wrong flag");
+                    g.wrong = g.runs - g.verified;
+                    updated += 1;
+                }
+            }
+        }
+        updated
+    }
+
+    fn report(&self) {
+        let mut verified = 0;
+        let mut single = 0;
+        let mut mismatching: Vec<(&String, i64, usize)> = Vec::new();
+        for (chunk_id, groups) in &self.chunks {
+            let runs: i64 = groups.iter().map(|g| g.runs).sum();
+            if groups.iter().any(|g| g.verified > 0) {
+                verified += 1;
+            } else if runs == 1 {
+                single += 1;
+            } else {
+                mismatching.push((chunk_id, runs, groups.len()));
+            }
+        }
+
+        println!();
+        println!("chunks with results:    {}", self.chunks.len());
+        println!("verified:               {}", verified);
+        println!("unverified, single run: {}", single);
+        println!("unverified, mismatch:   {}", mismatching.len());
+
+        mismatching.sort();
+        for (chunk_id, runs, distinct) in mismatching {
+            println!(
+                "  {}: {} runs, {} distinct results",
+                chunk_id, runs, distinct
+            );
+        }
+    }
+}
+
+fn write_file_to_db(conn: &Connection, file: &ScannedFile, cache: &mut VerificationCache) {
+    if let Some(old_id) = file.replaces {
+        let mut old_stmt = conn
+            .prepare_cached(
+                "SELECT chunk_id, total_chains, verified, wrong FROM chunks
+                 WHERE file_id = ?1 AND ignore = 0 AND corrupt = 0",
+            )
+            .expect("Failed to prepare outdated chunks query");
+        let old_results: Vec<(String, i64, i64, i64)> = old_stmt
+            .query_map(params![old_id], |r| {
+                Ok((r.get(0)?, r.get(1)?, r.get(2)?, r.get(3)?))
+            })
+            .expect("Failed to query outdated chunks")
+            .filter_map(Result::ok)
+            .collect();
+        for (chunk_id, total_chains, verified, wrong) in old_results {
+            cache.add(&chunk_id, total_chains, -1, -verified, -wrong);
+        }
+
+        conn.prepare_cached(
+            "DELETE FROM chunk_matrix
+             WHERE chunk_row_id IN (SELECT id FROM chunks WHERE file_id = ?1)",
+        )
+        .and_then(|mut stmt| stmt.execute(params![old_id]))
+        .and_then(|_| conn.prepare_cached("DELETE FROM chunks WHERE file_id = ?1"))
+        .and_then(|mut stmt| stmt.execute(params![old_id]))
+        .unwrap_or_else(|e| {
+            eprintln!("Failed to drop outdated chunks of {}: {}", file.db_path, e);
+            std::process::exit(1);
+        });
+    }
+
+    // a manually set ignore flag survives the re-ingestion of a changed file
+    let mut file_stmt = conn
+        .prepare_cached(
+            "INSERT INTO files (path, corrupt, ignore, size, mtime) VALUES (?1, ?2, ?3, ?4, ?5)
+             ON CONFLICT(path) DO UPDATE SET
+                 corrupt = excluded.corrupt,
+                 ignore = MAX(files.ignore, excluded.ignore),
+                 size = excluded.size,
+                 mtime = excluded.mtime
+             RETURNING id, ignore",
+        )
+        .expect("Failed to prepare file upsert");
 
     let mut chunk_stmt = conn
         .prepare_cached(
@@ -357,81 +635,117 @@ fn write_batch_to_db(conn: &Connection, batch: &[(String, Vec<ParsedChunk>, bool
         )
         .expect("Failed to prepare chunk_matrix insert");
 
-    for (path_str, parsed, file_corrupt, file_ignore) in batch {
-        file_stmt
-            .execute(params![path_str, *file_corrupt as i64, *file_ignore as i64])
+    let (file_id, file_ignore): (i64, i64) = file_stmt
+        .query_row(
+            params![
+                file.db_path,
+                file.corrupt as i64,
+                file.ignore as i64,
+                file.meta.size,
+                file.meta.mtime,
+            ],
+            |r| Ok((r.get(0)?, r.get(1)?)),
+        )
+        .unwrap_or_else(|e| {
+            eprintln!("Failed to insert file {}: {}", file.db_path, e);
+            std::process::exit(1);
+        });
+
+    for chunk in &file.parsed {
+        chunk_stmt
+            .execute(params![
+                file_id,
+                chunk.chunk_id,
+                chunk.total_chains as i64,
+                chunk.secs,
+                chunk.corrupt as i64,
+                file_ignore,
+            ])
             .unwrap_or_else(|e| {
-                eprintln!("Failed to insert file {}: {}", path_str, e);
+                eprintln!("Failed to insert chunk {}: {}", chunk.chunk_id, e);
                 0
             });
 
-        let file_id: i64 = file_id_stmt
-            .query_row(params![path_str], |r| r.get(0))
-            .unwrap_or_else(|e| {
-                eprintln!("Failed to fetch file id for {}: {}", path_str, e);
-                std::process::exit(1);
-            });
+        if !chunk.corrupt && file_ignore == 0 {
+            cache.add(&chunk.chunk_id, chunk.total_chains as i64, 1, 0, 0);
+        }
 
-        for chunk in parsed {
-            chunk_stmt
+        let chunk_row_id = conn.last_insert_rowid();
+
+        for (chain_length, row) in &chunk.matrix {
+            if row.sum == 0 {
+                continue;
+            }
+            matrix_stmt
                 .execute(params![
-                    file_id,
-                    chunk.chunk_id,
-                    chunk.total_chains as i64,
-                    chunk.secs,
-                    chunk.corrupt as i64,
-                    *file_ignore as i64,
+                    chunk_row_id,
+                    *chain_length as i64,
+                    row.n as i64,
+                    row.sum as i64,
+                    row.min as i64,
+                    row.max as i64,
                 ])
                 .unwrap_or_else(|e| {
-                    eprintln!("Failed to insert chunk {}: {}", chunk.chunk_id, e);
+                    eprintln!(
+                        "Failed to insert chunk_matrix row for chunk {}: {}",
+                        chunk.chunk_id, e
+                    );
                     0
                 });
-
-            let chunk_row_id = conn.last_insert_rowid();
-
-            for (chain_length, row) in &chunk.matrix {
-                if row.sum == 0 {
-                    continue;
-                }
-                matrix_stmt
-                    .execute(params![
-                        chunk_row_id,
-                        *chain_length as i64,
-                        row.n as i64,
-                        row.sum as i64,
-                        row.min as i64,
-                        row.max as i64,
-                    ])
-                    .unwrap_or_else(|e| {
-                        eprintln!(
-                            "Failed to insert chunk_matrix row for chunk {}: {}",
-                            chunk.chunk_id, e
-                        );
-                        0
-                    });
-            }
         }
     }
 }
 
+fn usage() -> ! {
+    eprintln!(
+        "Usage: progress [--db <path>] [requeue [--target-secs <secs>] [--command <cmd>] [--out <file>]]"
+    );
+    std::process::exit(1);
+}
+
 fn main() {
     let mut args = std::env::args().skip(1);
-    let db_path = if let Some(flag) = args.next() {
-        if flag == "--db" {
+    let mut db_path = "results.sqlite3".to_string();
+    let mut requeue: Option<jobs::RequeueOptions> = None;
+
+    while let Some(arg) = args.next() {
+        let mut value = || {
             args.next().unwrap_or_else(|| {
-                eprintln!("--db requires a path argument");
+                eprintln!("{} requires an argument", arg);
                 std::process::exit(1);
             })
-        } else {
-            eprintln!("Unknown argument: {}", flag);
-            std::process::exit(1);
+        };
+        match (arg.as_str(), requeue.as_mut()) {
+            ("--db", _) => db_path = value(),
+            ("requeue", None) => {
+                requeue = Some(jobs::RequeueOptions {
+                    target_secs: 3600.0,
+                    command: "full-search".to_string(),
+                    out: "requeue-jobs.txt".to_string(),
+                })
+            }
+            ("--target-secs", Some(options)) => {
+                options.target_secs = value().parse().unwrap_or_else(|_| usage())
+            }
+            ("--command", Some(options)) => options.command = value(),
+            ("--out", Some(options)) => options.out = value(),
+            _ => {
+                eprintln!("Unknown argument: {}", arg);
+                usage();
+            }
         }
-    } else {
-        "results.sqlite3".to_string()
-    };
+    }
 
     let conn = open_db(&db_path);
 
+    if let Some(options) = requeue {
+        jobs::requeue(&conn, &options).unwrap_or_else(|e| {
+            eprintln!("Failed to write {}: {}", options.out, e);
+            std::process::exit(1);
+        });
+        return;
+    }
+
     // Resolve the DB directory and current working directory once, so all
     // stored paths are relative to the DB file's location.
     let db_dir = Path::new(&db_path)
@@ -448,23 +762,26 @@ fn main() {
         std::process::exit(1);
     });
 
-    // Fetch all already-processed file paths in one query.
-    let seen: HashSet<String> = {
+    // Fetch all already-processed files with their fingerprints in one query.
+    let seen: HashMap<String, (i64, Option<i64>, Option<i64>)> = {
         let mut stmt = conn
-            .prepare("SELECT path FROM files")
+            .prepare("SELECT path, id, size, mtime FROM files")
             .expect("Failed to prepare seen-files query");
-        stmt.query_map([], |r| r.get(0))
+        stmt.query_map([], |r| Ok((r.get(0)?, (r.get(1)?, r.get(2)?, r.get(3)?))))
             .expect("Failed to query seen files")
             .filter_map(Result::ok)
             .collect()
     };
 
-    let conn = Mutex::new(conn);
+    // Files ingested before fingerprinting was introduced, to be stamped with
+    // their current size and mtime instead of being parsed again.
+    let mut unstamped: Vec<(i64, FileMeta)> = Vec::new();
 
-    // Each entry is (open_path, db_path):
+    // Each entry is (open_path, db_path, meta, replaces):
     // - open_path: CWD-relative, used to open the file
     // - db_path:   DB-dir-relative, used for storage and dedup
-    let files: Vec<(PathBuf, String)> = WalkDir::new(".")
+    // - replaces:  files.id of an outdated ingestion of a changed file
+    let files: Vec<(PathBuf, String, FileMeta, Option<i64>)> = WalkDir::new(".")
         .into_iter()
         .filter_map(Result::ok)
         .filter_map(|e| {
@@ -495,15 +812,49 @@ fn main() {
                 }
             };
 
-            if seen.contains(&db_rel) {
-                return None;
-            }
+            let meta = FileMeta::of(&e.metadata().ok()?);
 
-            Some((e.path().to_path_buf(), db_rel))
+            let replaces = match seen.get(&db_rel) {
+                None => None,
+                Some(&(id, Some(size), Some(mtime))) => {
+                    if (FileMeta { size, mtime }) == meta {
+                        return None;
+                    }
+                    Some(id)
+                }
+                Some(&(id, _, _)) => {
+                    unstamped.push((id, meta));
+                    return None;
+                }
+            };
+
+            Some((e.path().to_path_buf(), db_rel, meta, replaces))
         })
         .collect();
 
-    println!("Files to parse: {}", files.len());
+    if !unstamped.is_empty() {
+        conn.execute_batch("BEGIN")
+            .expect("Failed to begin transaction");
+        {
+            let mut stmt = conn
+                .prepare("UPDATE files SET size = ?2, mtime = ?3 WHERE id = ?1")
+                .expect("Failed to prepare file stamp update");
+            for (id, meta) in &unstamped {
+                stmt.execute(params![id, meta.size, meta.mtime])
+                    .expect("Failed to stamp file");
+            }
+        }
+        conn.execute_batch("COMMIT")
+            .expect("Failed to commit transaction");
+        println!("Stamped previously ingested files: {}", unstamped.len());
+    }
+
+    let num_changed = files.iter().filter(|f| f.3.is_some()).count();
+    println!(
+        "Files to parse: {} ({} changed since the last scan)",
+        files.len(),
+        num_changed
+    );
 
     let pb = ProgressBar::new(files.len() as u64);
     pb.set_style(
@@ -514,71 +865,88 @@ fn main() {
     );
     pb.tick();
 
-    const BATCH_SIZE: usize = 1000;
-
-    let final_stats = files
-        .par_chunks(BATCH_SIZE)
-        .map(|batch| {
-            // Parse all files in this batch sequentially — no lock held during parsing.
-            let mut batch_stats = Stats::default();
-            let mut results: Vec<(String, Vec<ParsedChunk>, bool, bool)> =
-                Vec::with_capacity(batch.len());
-
-            for (open_path, db_path) in batch {
-                let (stats, parsed, file_corrupt) = process_file(open_path);
-
-                let file_ignore = open_path
-                    .file_name()
-                    .and_then(|n| n.to_str())
-                    .and_then(|n| n.strip_suffix("__file_output"))
-                    .map(|base| jobs::JOBS_TO_IGNORE.contains(base))
-                    .unwrap_or(false);
-
-                batch_stats.total_chains += stats.total_chains;
-                batch_stats.total_secs += stats.total_secs;
-                for (k, row_b) in stats.matrix.iter() {
-                    batch_stats
-                        .matrix
-                        .entry(*k)
-                        .and_modify(|row_a| row_a.merge(row_b))
-                        .or_insert_with(|| row_b.clone());
-                }
+    // Parsing runs on all cores, while a single writer thread owns the
+    // connection and commits in large transactions. The bounded channel keeps
+    // parsers from running arbitrarily far ahead of the writer.
+    const CHANNEL_BOUND: usize = 4096;
+    const TRANSACTION_SIZE: usize = 10_000;
 
-                results.push((db_path.clone(), parsed, file_corrupt, file_ignore));
-            }
+    let (tx, rx) = mpsc::sync_channel::<ScannedFile>(CHANNEL_BOUND);
 
-            // Write the entire batch in a single transaction.
-            {
-                let conn = conn.lock().unwrap();
+    let mut cache = VerificationCache::load(&conn);
+
+    let writer_pb = pb.clone();
+    let writer = thread::spawn(move || {
+        let mut total = Stats::default();
+        let mut in_transaction = 0;
+
+        for file in rx {
+            if in_transaction == 0 {
                 conn.execute_batch("BEGIN")
                     .expect("Failed to begin transaction");
-                write_batch_to_db(&conn, &results);
+            }
+
+            write_file_to_db(&conn, &file, &mut cache);
+            total.merge(&file.stats);
+
+            in_transaction += 1;
+            if in_transaction == TRANSACTION_SIZE {
                 conn.execute_batch("COMMIT")
                     .expect("Failed to commit transaction");
+                in_transaction = 0;
             }
 
-            pb.inc(batch.len() as u64);
-            batch_stats
-        })
-        .reduce(
-            || Stats::default(),
-            |mut a, b| {
-                a.total_chains += b.total_chains;
-                a.total_secs += b.total_secs;
-
-                for (k, row_b) in b.matrix.iter() {
-                    a.matrix
-                        .entry(*k)
-                        .and_modify(|row_a| row_a.merge(row_b))
-                        .or_insert_with(|| row_b.clone());
-                }
+            writer_pb.inc(1);
+        }
 
-                a
-            },
-        );
+        if in_transaction > 0 {
+            conn.execute_batch("COMMIT")
+                .expect("Failed to commit transaction");
+        }
+
+        conn.execute_batch("BEGIN")
+            .expect("Failed to begin transaction");
+        let updated = cache.apply(&conn);
+        conn.execute_batch("COMMIT")
+            .expect("Failed to commit transaction");
+        writer_pb.println(format!(
+            "Updated verified/wrong flags of {} result groups",
+            updated
+        ));
+
+        (total, cache)
+    });
+
+    files
+        .into_par_iter()
+        .for_each_with(tx, |tx, (open_path, db_path, meta, replaces)| {
+            let (stats, parsed, corrupt) = process_file(&open_path);
+
+            let ignore = open_path
+                .file_name()
+                .and_then(|n| n.to_str())
+                .and_then(|n| n.strip_suffix("__file_output"))
+                .map(|base| jobs::JOBS_TO_IGNORE.contains(base))
+                .unwrap_or(false);
+
+            tx.send(ScannedFile {
+                db_path,
+                meta,
+                replaces,
+                parsed,
+                corrupt,
+                ignore,
+                stats,
+            })
+            .expect("Writer thread stopped");
+        });
+
+    let (final_stats, cache) = writer.join().expect("Writer thread panicked");
 
     pb.finish_with_message("done");
 
+    cache.report();
+
     if final_stats.total_chains > 0 {
         println!();
         println!("total number of chains: {}", final_stats.total_chains);
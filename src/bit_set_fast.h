@@ -65,6 +65,14 @@ public:
     return bit_set[index] & (1ULL << bit_index);
   }
 
+  // the 64 bits starting at 64 * index, zero past the end like get()
+  uint64_t word(const size_t index) const {
+    if (ARRAY_SIZE <= index) {
+      return 0;
+    }
+    return bit_set[index];
+  }
+
   void insert(uint32_t bit) {
     uint32_t index = bit >> 6;
     uint32_t bit_index = bit & 0b111111;
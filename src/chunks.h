@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+// A job can hand several chunks to one process instead of starting it once
+// per chunk. The chunks are given either as arguments separated by "##", e.g.
+//   full-search 0 1 2 3 4 ## 0 1 2 3 5
+// or with "-f <file>", one chunk per line, in the same format as the plan
+// files. A single chunk without "-f" behaves exactly like before.
+//
+// When more than one chunk is run, every chunk's output is wrapped in the same
+// section boinc-central/main.sh writes around each command, including the
+// timings of `time`, so progress can parse the output unchanged.
+
+typedef std::vector<std::string> ChunkArgs;
+
+struct ChunkList {
+  std::vector<ChunkArgs> chunks;
+  // true if the chunks came from "-f" or "##", i.e. output gets wrapped
+  bool wrapped = false;
+};
+
+// returns false if the chunk file can't be read
+bool read_chunks(const int argc, char *argv[], const int first,
+                 ChunkList &list) {
+  if (argc == first + 2 && strcmp(argv[first], "-f") == 0) {
+    FILE *file = fopen(argv[first + 1], "r");
+    if (file == nullptr) {
+      printf("couldn't open chunk file %s\n", argv[first + 1]);
+      return false;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+      ChunkArgs args;
+      for (char *token = strtok(line, " \t\r\n"); token != nullptr;
+           token = strtok(nullptr, " \t\r\n")) {
+        args.push_back(token);
+      }
+      if (!args.empty()) {
+        list.chunks.push_back(args);
+      }
+    }
+    fclose(file);
+
+    list.wrapped = true;
+    return true;
+  }
+
+  list.chunks.emplace_back();
+  for (int i = first; i < argc; i++) {
+    if (strcmp(argv[i], "##") == 0) {
+      list.chunks.emplace_back();
+      list.wrapped = true;
+      continue;
+    }
+    list.chunks.back().push_back(argv[i]);
+  }
+
+  return true;
+}
+
+// --shard i/n[@depth] has the search enumerate the chunks itself instead of
+// reading them, and run those whose prefix up to the chain length depth is
+// the i-th of every n prefixes, with the whole subtree of the prefix, e.g.
+//   full-search --shard 3/100        hungry-search --shard 0/8@6
+// Every chunk belongs to exactly one shard and its output is the same as
+// when it's given as arguments. The default depth is the search's own.
+struct Shard {
+  uint32_t index = 0;
+  uint32_t count = 0;
+  uint32_t depth = 0;
+
+  bool enabled() const { return count != 0; }
+
+  // consumes --shard i/n[@depth], exits on a malformed one
+  bool parse_arg(const int argc, char *argv[], int &arg) {
+    if (arg + 1 >= argc || strcmp(argv[arg], "--shard") != 0) {
+      return false;
+    }
+    const int parsed = sscanf(argv[arg + 1], "%u/%u@%u", &index, &count,
+                              &depth);
+    if (parsed < 2 || count == 0 || index >= count) {
+      printf("expected --shard i/n[@depth] with i < n, got %s\n",
+             argv[arg + 1]);
+      exit(-1);
+    }
+    arg += 2;
+    return true;
+  }
+
+  bool owns(const uint64_t position) const {
+    return position % count == index;
+  }
+};
+
+struct ChunkTimer {
+  timespec start_wall;
+  rusage start_usage;
+
+  void start() {
+    clock_gettime(CLOCK_MONOTONIC, &start_wall);
+    getrusage(RUSAGE_SELF, &start_usage);
+  }
+
+  static void print_time(const char *name, const double secs) {
+    const uint32_t mins = (uint32_t)(secs / 60);
+    printf("%s\t%um%.3fs\n", name, mins, secs - mins * 60.0);
+  }
+
+  static double secs(const timeval &from, const timeval &to) {
+    return (to.tv_sec - from.tv_sec) + (to.tv_usec - from.tv_usec) / 1e6;
+  }
+
+  // prints the timings in the format of bash's `time`
+  void print() const {
+    timespec end_wall;
+    rusage end_usage;
+    clock_gettime(CLOCK_MONOTONIC, &end_wall);
+    getrusage(RUSAGE_SELF, &end_usage);
+
+    printf("\n");
+    print_time("real", (end_wall.tv_sec - start_wall.tv_sec) +
+                           (end_wall.tv_nsec - start_wall.tv_nsec) / 1e9);
+    print_time("user", secs(start_usage.ru_utime, end_usage.ru_utime));
+    print_time("sys", secs(start_usage.ru_stime, end_usage.ru_stime));
+  }
+};
+
+#define CHUNK_SEPARATOR "----------------------------------------"
+
+void print_chunk_begin(const char *program, const ChunkArgs &args) {
+  printf("Running command: %s", program);
+  for (const auto &arg : args) {
+    printf(" %s", arg.c_str());
+  }
+  printf("\n" CHUNK_SEPARATOR "\n");
+  fflush(stdout);
+}
+
+void print_chunk_end(const ChunkTimer &timer) {
+  timer.print();
+  printf(CHUNK_SEPARATOR "\n\n");
+  fflush(stdout);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// The images are built for the baseline of their architecture, e.g.
+// -march=x86-64, so they run on every host. The hot functions are marked with
+// CPU_DISPATCH_CLONES instead, which compiles them once per instruction set,
+// and the loader picks the best variant for the host at startup. The variant
+// is printed in the header line. -DCPU_DISPATCH=0 turns it off, e.g. for
+// -march=native builds, where it gains nothing.
+//
+// Only clone what measures faster: AVX2 and AVX-512 speed up hungry-search's
+// algorithm L, but make full-search's DFS slower than the x86-64 baseline.
+#ifndef CPU_DISPATCH
+#if defined(__x86_64__)
+#define CPU_DISPATCH 1
+#else
+#define CPU_DISPATCH 0
+#endif
+#endif
+
+#if CPU_DISPATCH
+#define CPU_DISPATCH_CLONES                                                    \
+  __attribute__((                                                              \
+      target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define CPU_DISPATCH_CLONES
+#endif
+
+// the variant the loader picks, in the same order as the clones
+const char *cpu_variant() {
+#if CPU_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512cd") &&
+      __builtin_cpu_supports("avx512dq") &&
+      __builtin_cpu_supports("avx512vl")) {
+    return "x86-64-v4";
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") &&
+      __builtin_cpu_supports("fma")) {
+    return "x86-64-v3";
+  }
+#endif
+  return "default";
+}
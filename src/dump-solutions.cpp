@@ -0,0 +1,85 @@
+#include "solutions.h"
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// prints the chains of a solutions file written by full-search's COLLECT_ALL
+// mode in print_chain's format, of either record layout, e.g.
+//   dump-solutions solutions.bin
+//   dump-solutions -c solutions.bin       only the number of chains
+//   dump-solutions -l 17 solutions.bin    only the chains of length 17
+
+void print_bits(const uint64_t f, const uint32_t n) {
+  for (int32_t i = n - 1; i >= 0; i--) {
+    putchar('0' + ((f >> i) & 1));
+  }
+}
+
+void print_record(const SolutionRecord &record, const uint32_t n) {
+  printf("target set: %d\n", record.target_set);
+  printf("chain (%d):\n", record.length);
+  for (uint32_t i = 0; i < record.length; i++) {
+    printf("x%d", i + 1);
+    if (record.ops[i]) {
+      printf(" = x%d %c x%d", record.operands[i][0] + 1, record.ops[i],
+             record.operands[i][1] + 1);
+    }
+    printf(" = ");
+    print_bits(record.functions[i], n);
+    printf("\n");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool count_only = false;
+  uint32_t length = 0;
+  int arg = 1;
+  while (arg < argc - 1) {
+    if (strcmp(argv[arg], "-c") == 0) {
+      count_only = true;
+      arg++;
+    } else if (strcmp(argv[arg], "-l") == 0 && arg + 2 < argc) {
+      length = atoi(argv[arg + 1]);
+      arg += 2;
+    } else {
+      break;
+    }
+  }
+  if (arg != argc - 1) {
+    printf("usage: %s [-c] [-l <length>] <solutions file>\n", argv[0]);
+    return -1;
+  }
+
+  FILE *file = fopen(argv[arg], "rb");
+  if (file == nullptr) {
+    printf("couldn't open %s\n", argv[arg]);
+    return -1;
+  }
+
+  SolutionsHeader header;
+  if (!read_solutions_header(file, header)) {
+    printf("%s is not a solutions file\n", argv[arg]);
+    fclose(file);
+    return -1;
+  }
+
+  uint64_t num_chains = 0;
+  uint8_t bytes[sizeof(SolutionRecord)];
+  SolutionRecord record;
+  while (fread(bytes, header.record_size, 1, file) == 1) {
+    unpack_solution(bytes, header, record);
+    if (length && record.length != length) {
+      continue;
+    }
+    num_chains++;
+    if (!count_only) {
+      print_record(record, header.n);
+    }
+  }
+  fclose(file);
+
+  printf("chains: %" PRIu64 "\n", num_chains);
+  return 0;
+}
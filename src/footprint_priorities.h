@@ -0,0 +1,73 @@
+#pragma once
+
+#include "bit_set_fast.h"
+#include <algorithm>
+#include <cstdint>
+
+// The order in which hungry-search tries the first expressions, also used by
+// reverse-hungry-search to find the indices of a chain, so both have to make
+// the same choices. An expression is in the footprint of a target if the
+// cheapest chains of the target found by Algorithm L use it, the expressions
+// in the footprint of the cheapest target come first, then those in more
+// footprints, and of those the later expression.
+
+// counts in how many target footprints each first expression is and finds
+// the lowest cost of those targets, a word of 64 expressions at a time, the
+// keys order like the tuple (lowest target cost, -frequency, -index)
+template <uint32_t NUM_TARGETS, typename Cost>
+void footprint_priority_keys(const BitSet *footprints, const Cost *costs,
+                             const uint32_t *targets, uint32_t *priority_keys,
+                             const uint32_t expressions_size) {
+  static_assert(NUM_TARGETS < 8, "frequencies are counted in three bits");
+  const size_t num_words = (expressions_size + 63) / 64;
+  const size_t footprint_words = min(num_words, ARRAY_SIZE);
+
+  // the footprints of the targets, transposed to one row of words per target
+  uint64_t target_words[NUM_TARGETS][ARRAY_SIZE];
+  uint32_t order[NUM_TARGETS];
+  for (size_t t = 0; t < NUM_TARGETS; t++) {
+    for (size_t w = 0; w < footprint_words; w++) {
+      target_words[t][w] = footprints[targets[t]].word(w);
+    }
+    order[t] = t;
+  }
+  sort(order, order + NUM_TARGETS, [&](uint32_t x, uint32_t y) {
+    return costs[targets[x]] < costs[targets[y]];
+  });
+
+  // expressions in no footprint, including those past the footprints' end
+  for (size_t i = 0; i < expressions_size; i++) {
+    priority_keys[i] = (1000 << 19) | (7 << 16) | (0xffff - i);
+  }
+
+  for (size_t w = 0; w < footprint_words; w++) {
+    // bit-sliced counters, bit b of count_k is bit k of the count of 64w+b
+    uint64_t count_0 = 0, count_1 = 0, count_2 = 0;
+    for (size_t t = 0; t < NUM_TARGETS; t++) {
+      const uint64_t x = target_words[t][w];
+      const uint64_t carry_0 = count_0 & x;
+      count_0 ^= x;
+      const uint64_t carry_1 = count_1 & carry_0;
+      count_1 ^= carry_0;
+      count_2 |= carry_1;
+    }
+
+    // the cheapest target claims its expressions first
+    uint64_t remaining = count_0 | count_1 | count_2;
+    for (size_t t = 0; t < NUM_TARGETS && remaining != 0; t++) {
+      uint64_t hits = target_words[order[t]][w] & remaining;
+      remaining &= ~hits;
+      const uint32_t cost = costs[targets[order[t]]];
+      while (hits != 0) {
+        const uint32_t b = __builtin_ctzll(hits);
+        hits &= hits - 1;
+        const uint32_t frequency = ((count_0 >> b) & 1) |
+                                   (((count_1 >> b) & 1) << 1) |
+                                   (((count_2 >> b) & 1) << 2);
+        const uint32_t i = w * 64 + b;
+        priority_keys[i] =
+            (cost << 19) | ((7 - frequency) << 16) | (0xffff - i);
+      }
+    }
+  }
+}
@@ -1,9 +1,19 @@
+#include "chunks.h"
+#include "heartbeat.h"
+#include "instrument.h"
+#include "segment_targets.h"
+#include "solutions.h"
+#include "truth_table.h"
+#include "worker.h"
+#include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cinttypes>
 #include <csignal>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <set>
 
 #ifndef CAPTURE_STATS
 #define CAPTURE_STATS 1
@@ -13,6 +23,57 @@
 #define PLAN_MODE 0
 #endif
 
+// skip the endgame when no unfulfilled target can be the next expression,
+// only checked when the endgame is entered, not at every level, the skipped
+// endgame's expressions are still counted, so the total chains don't change,
+// the cuts are printed with the summary
+#ifndef BOUND_PRUNING
+#define BOUND_PRUNING 0
+#endif
+
+// compare the endgame's expressions with the targets using vector registers
+// instead of looking them up in unseen, the output is the same
+#ifndef SIMD_ENDGAME
+#define SIMD_ENDGAME 0
+#endif
+
+// don't stop at the first chain of an endgame, every chain is written to the
+// binary solutions file given with -s <file>, solutions.bin by default, see
+// src/solutions.h, a chain that was already found in the chunk is skipped
+#ifndef COLLECT_ALL
+#define COLLECT_ALL 0
+#endif
+
+// keep the derivation of every expression next to it, so a chain is printed
+// with the operation and operands that generated its functions instead of
+// searching all pairs for them, on by default when every chain is collected
+#ifndef RECORD_DERIVATIONS
+#define RECORD_DERIVATIONS COLLECT_ALL
+#endif
+
+// count per chain length the nodes, the endgames, the endgames that completed
+// a chain and the pruned branches, and the hardware counters of the levels up
+// to INSTRUMENT_PERF_DEPTH, the deepest of them includes the levels below it,
+// see src/instrument.h, printed with the summary and appended as one JSON
+// object per chunk to the file given with -i <file>, instrument.json by
+// default
+#ifndef INSTRUMENT
+#define INSTRUMENT 0
+#endif
+#ifndef INSTRUMENT_PERF_DEPTH
+#define INSTRUMENT_PERF_DEPTH 10
+#endif
+
+// search chains for several target sets in one traversal, e.g. the segment
+// variants, instead of enumerating the same expressions once per set. The
+// header defines `constexpr word_t TARGET_SETS[][W]`, one set per row, padded
+// with 0, e.g. -DTARGET_SETS_HEADER='"sets.h"'
+#ifdef TARGET_SETS_HEADER
+#define MULTI_TARGET_SETS 1
+#else
+#define MULTI_TARGET_SETS 0
+#endif
+
 #define CHUNK_START_LENGTH 9
 
 #if CAPTURE_STATS
@@ -34,28 +95,46 @@
 #endif
 
 constexpr uint32_t N = 16;
-constexpr uint32_t SIZE = 1 << (N - 1);
+typedef truth_table_t<N> word_t;
+typedef unseen_t<word_t, N> Unseen;
+typedef unseen_ref_t<Unseen> UnseenRef;
+typedef const_unseen_ref_t<Unseen> ConstUnseenRef;
 constexpr uint32_t MAX_LENGTH = 22;
 constexpr uint32_t PRINT_PROGRESS_LENGTH = 10;
-constexpr uint32_t TAUTOLOGY = (1 << N) - 1;
-constexpr uint32_t TARGET_1 =
-    ((~(uint32_t)0b1011011111100011) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_2 =
-    ((~(uint32_t)0b1111100111100100) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_3 =
-    ((~(uint32_t)0b1101111111110100) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_4 =
-    ((~(uint32_t)0b1011011011011110) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_5 =
-    ((~(uint32_t)0b1010001010111111) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_6 =
-    ((~(uint32_t)0b1000111111110011) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_7 =
-    (((uint32_t)0b0011111011111111) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGETS[] = {
+constexpr word_t TAUTOLOGY = ~(word_t)0 >> (8 * sizeof(word_t) - N);
+constexpr uint32_t NUM_INPUTS = N <= 16 ? 4 : num_inputs(N);
+#if MULTI_TARGET_SETS
+#include TARGET_SETS_HEADER
+constexpr uint32_t NUM_TARGET_SETS =
+    sizeof(TARGET_SETS) / sizeof(TARGET_SETS[0]);
+// the largest set, the shorter ones are padded with 0
+constexpr uint32_t NUM_TARGETS = sizeof(TARGET_SETS[0]) / sizeof(word_t);
+// bit 1 + s of unseen marks the targets of set s
+static_assert(NUM_TARGET_SETS <= 7, "at most 7 target sets");
+static_assert(!BOUND_PRUNING && !SIMD_ENDGAME,
+              "target sets don't support BOUND_PRUNING and SIMD_ENDGAME");
+#elif defined(TARGETS_HEADER)
+// other displays or wider truth tables, the header defines
+// `constexpr word_t TARGETS[]` with the first row of every target 0, e.g.
+// -DTARGETS_HEADER='"targets.h"'
+#include TARGETS_HEADER
+#else
+static_assert(N <= 16, "the 7-segment targets have 16 rows, "
+                       "N > 16 needs -DTARGETS_HEADER");
+constexpr word_t TARGET_1 = SEGMENT_TARGETS[0] >> (16 - N);
+constexpr word_t TARGET_2 = SEGMENT_TARGETS[1] >> (16 - N);
+constexpr word_t TARGET_3 = SEGMENT_TARGETS[2] >> (16 - N);
+constexpr word_t TARGET_4 = SEGMENT_TARGETS[3] >> (16 - N);
+constexpr word_t TARGET_5 = SEGMENT_TARGETS[4] >> (16 - N);
+constexpr word_t TARGET_6 = SEGMENT_TARGETS[5] >> (16 - N);
+constexpr word_t TARGET_7 = SEGMENT_TARGETS[6] >> (16 - N);
+constexpr word_t TARGETS[] = {
     TARGET_1, TARGET_2, TARGET_3, TARGET_4, TARGET_5, TARGET_6, TARGET_7,
 };
-constexpr uint32_t NUM_TARGETS = sizeof(TARGETS) / sizeof(uint32_t);
+#endif
+#if !MULTI_TARGET_SETS
+constexpr uint32_t NUM_TARGETS = sizeof(TARGETS) / sizeof(word_t);
+#endif
 
 uint32_t plan_depth = 1;
 
@@ -68,6 +147,118 @@ uint32_t stats_min_num_expressions[25] = {UNDEFINED};
 uint32_t stats_max_num_expressions[25] = {0};
 uint64_t stats_num_data_points[25] = {0};
 #endif
+#if BOUND_PRUNING
+uint64_t stats_bound_cuts[25] = {0};
+#endif
+#if INSTRUMENT
+uint64_t instrument_nodes[25] = {0};
+uint64_t instrument_endgames[25] = {0};
+uint64_t instrument_endgame_successes[25] = {0};
+uint64_t instrument_pruned[25] = {0};
+uint64_t instrument_chains_found = 0;
+// the hardware counters of every level, at INSTRUMENT_PERF_DEPTH including
+// the levels below it
+uint64_t instrument_perf[25][NUM_PERF_COUNTERS] = {{0}};
+uint64_t instrument_perf_last[NUM_PERF_COUNTERS] = {0};
+uint32_t instrument_level = 0;
+PerfCounters perf_counters;
+FILE *instrument_file = nullptr;
+std::string instrument_chunk;
+
+// the counters since the last switch belong to the level that ran, from now
+// on they belong to level
+void instrument_switch(const uint32_t level) {
+  uint64_t values[NUM_PERF_COUNTERS];
+  perf_counters.read(values);
+  for (uint32_t c = 0; c < NUM_PERF_COUNTERS; c++) {
+    instrument_perf[instrument_level][c] += values[c] - instrument_perf_last[c];
+    instrument_perf_last[c] = values[c];
+  }
+  instrument_level = level;
+}
+
+#define INSTRUMENT_NODE(CS)                                                    \
+  instrument_nodes[CS]++;                                                      \
+  if (CS <= INSTRUMENT_PERF_DEPTH) {                                           \
+    instrument_switch(CS);                                                     \
+  }
+#define INSTRUMENT_LEVEL_DONE(CS, PREV_CS)                                     \
+  if (CS <= INSTRUMENT_PERF_DEPTH) {                                           \
+    instrument_switch(PREV_CS);                                                \
+  }
+// a target ends the level, the expressions after it are skipped
+#define INSTRUMENT_TARGET_CUT(CS)                                              \
+  instrument_pruned[CS] += is_target ? limit_##CS - i##CS - 1 : 0;
+#define INSTRUMENT_LEVEL_CUT(CS)                                               \
+  instrument_pruned[CS] += limit_##CS - i##CS - 1;
+#define INSTRUMENT_BOUND_CUT(CS) instrument_pruned[CS]++;
+#define INSTRUMENT_ENDGAME_BEGIN(CS)                                           \
+  const uint64_t chains_found = instrument_chains_found;                       \
+  instrument_endgames[CS]++;
+#define INSTRUMENT_ENDGAME_END(CS)                                             \
+  instrument_endgame_successes[CS] += instrument_chains_found != chains_found;
+#define INSTRUMENT_FOUND instrument_chains_found++;
+#else
+#define INSTRUMENT_NODE(CS)
+#define INSTRUMENT_LEVEL_DONE(CS, PREV_CS)
+#define INSTRUMENT_TARGET_CUT(CS)
+#define INSTRUMENT_LEVEL_CUT(CS)
+#define INSTRUMENT_BOUND_CUT(CS)
+#define INSTRUMENT_ENDGAME_BEGIN(CS)
+#define INSTRUMENT_ENDGAME_END(CS)
+#define INSTRUMENT_FOUND
+#endif
+#if RECORD_DERIVATIONS
+// op | j << 8 | k << 16 for expressions[i] = chain[j] op chain[k], op is one
+// of & | ^ < > like in print_chain, 0 for the inputs
+uint32_t expression_derivations[1000];
+uint32_t chain_derivations[25] = {0};
+#endif
+
+// set while a chunk runs, so an interrupted chunk still prints its summary
+bool chunk_running = false;
+bool chunk_wrapped = false;
+ChunkTimer chunk_timer;
+Heartbeat heartbeat;
+// the chains and the choices and the ends of the levels up to
+// PRINT_PROGRESS_LENGTH for the heartbeat thread, which doesn't read main's,
+// so they don't escape, the search publishes them with relaxed stores, which
+// are plain moves, and the thread loads them, so a sample is at most a node
+// stale
+std::atomic<uint64_t> heartbeat_chains;
+std::atomic<uint32_t> heartbeat_choices[PRINT_PROGRESS_LENGTH + 1];
+std::atomic<uint32_t> heartbeat_limits[PRINT_PROGRESS_LENGTH + 1];
+
+#define HEARTBEAT_CHOICE(CS, i, limit)                                         \
+  if (!PLAN_MODE) {                                                            \
+    heartbeat_chains.store(total_chains, std::memory_order_relaxed);           \
+    if (CS <= PRINT_PROGRESS_LENGTH) {                                         \
+      heartbeat_choices[CS].store(i, std::memory_order_relaxed);               \
+      heartbeat_limits[CS].store(limit, std::memory_order_relaxed);            \
+    }                                                                          \
+  }
+
+// the chunk's levels 9 and 10 run from the index after the last level's
+// choice to the end of their expressions
+void sample_heartbeat(HeartbeatSample &sample) {
+  sample.chains = heartbeat_chains.load(std::memory_order_relaxed);
+  uint32_t choices[PRINT_PROGRESS_LENGTH + 1];
+  uint32_t limits[PRINT_PROGRESS_LENGTH + 1];
+  for (uint32_t i = 0; i <= PRINT_PROGRESS_LENGTH; i++) {
+    choices[i] = heartbeat_choices[i].load(std::memory_order_relaxed);
+    limits[i] = heartbeat_limits[i].load(std::memory_order_relaxed);
+  }
+  const double fraction_10 =
+      level_fraction(choices[10], choices[9] + 1, limits[10], 0);
+  sample.fraction =
+      level_fraction(choices[9], choices[8] + 1, limits[9], fraction_10);
+  for (uint32_t i = start_chain_length; i <= PRINT_PROGRESS_LENGTH; i++) {
+    char choice[16];
+    snprintf(choice, sizeof(choice), i == start_chain_length ? "%u" : " %u",
+             choices[i]);
+    sample.choices += choice;
+  }
+}
 
 #define PRINT_PROGRESS(chain_size, last)                                       \
   for (uint32_t j = start_chain_length; j < chain_size; ++j) {                 \
@@ -76,75 +267,134 @@ uint64_t stats_num_data_points[25] = {0};
   printf("%d %" PRIu64 "\n", last, total_chains);                              \
   fflush(stdout);
 
-#define ADD_EXPRESSION(value, chain_size)                                      \
+// the bits of unseen that mark targets, they stay when an expression is added
+#if MULTI_TARGET_SETS
+#define TARGET_FLAGS 0xfe
+#else
+#define TARGET_FLAGS 2
+#endif
+
+#define DERIVATION(op, j, k)                                                   \
+  ((uint32_t)(op) | ((uint32_t)(j) << 8) | ((uint32_t)(k) << 16))
+#if RECORD_DERIVATIONS
+#define RECORD_DERIVATION(index, derivation)                                   \
+  expression_derivations[index] = derivation;
+#define CHOOSE_DERIVATION(CS, index)                                           \
+  chain_derivations[CS] = expression_derivations[index];
+#else
+#define RECORD_DERIVATION(index, derivation)
+#define CHOOSE_DERIVATION(CS, index)
+#endif
+
+#define ADD_EXPRESSION(value, derivation)                                      \
   {                                                                            \
     const uint8_t u = unseen[value];                                           \
     expressions[_expr_size] = value;                                           \
+    RECORD_DERIVATION(_expr_size, derivation)                                  \
     _expr_size += u & 1;                                                       \
-    unseen[value] = u & 2;                                                     \
+    unseen[value] = u & TARGET_FLAGS;                                          \
   }
 
-#define ADD_EXPRESSION_TARGET(value, chain_size)                               \
+#if MULTI_TARGET_SETS
+// only the targets of the endgame's set, target_flag
+#define ADD_EXPRESSION_TARGET(value, derivation)                               \
+  {                                                                            \
+    const uint8_t u = unseen[value];                                           \
+    if (__builtin_expect((u & (target_flag | 1)) == (target_flag | 1), 0)) {   \
+      expressions[_expr_size] = value;                                         \
+      RECORD_DERIVATION(_expr_size, derivation)                                \
+      ++_expr_size;                                                            \
+      unseen[value] = u & TARGET_FLAGS;                                        \
+    }                                                                          \
+  }
+
+#define FULFILL_TARGETS(sets)                                                  \
+  for (uint32_t s = 0; s < NUM_TARGET_SETS; s++) {                             \
+    num_unfulfilled_targets[s] -= ((sets) >> s) & 1;                           \
+  }
+#define UNFULFILL_TARGETS(sets)                                                \
+  for (uint32_t s = 0; s < NUM_TARGET_SETS; s++) {                             \
+    num_unfulfilled_targets[s] += ((sets) >> s) & 1;                           \
+  }
+#else
+#define ADD_EXPRESSION_TARGET(value, derivation)                               \
   {                                                                            \
     if (__builtin_expect(unseen[value] == 3, 0)) {                             \
       expressions[_expr_size] = value;                                         \
+      RECORD_DERIVATION(_expr_size, derivation)                                \
       ++_expr_size;                                                            \
       unseen[value] = 2;                                                       \
     }                                                                          \
   }
 
+#define FULFILL_TARGETS(sets) num_unfulfilled_targets -= (sets);
+#define UNFULFILL_TARGETS(sets) num_unfulfilled_targets += (sets);
+#endif
+
 #define GENERATE_NEW_EXPRESSIONS(chain_size, add_expression)                   \
   {                                                                            \
     uint32_t _expr_size = expressions_size[chain_size - 1];                    \
-    const uint32_t h = chain[chain_size - 1];                                  \
-    const uint32_t not_h = not_chain[chain_size - 1];                          \
+    const word_t h = chain[chain_size - 1];                                    \
+    const word_t not_h = not_chain[chain_size - 1];                            \
                                                                                \
     uint32_t j = 0;                                                            \
     _Pragma("loop unroll(full)") for (; j < chain_size - 4; j += 4) {          \
-      const uint32_t g0 = chain[j], g1 = chain[j + 1], g2 = chain[j + 2],      \
-                     g3 = chain[j + 3];                                        \
-      const uint32_t not_g0 = not_chain[j], not_g1 = not_chain[j + 1],         \
-                     not_g2 = not_chain[j + 2], not_g3 = not_chain[j + 3];     \
+      const word_t g0 = chain[j], g1 = chain[j + 1], g2 = chain[j + 2],        \
+                   g3 = chain[j + 3];                                          \
+      const word_t not_g0 = not_chain[j], not_g1 = not_chain[j + 1],           \
+                   not_g2 = not_chain[j + 2], not_g3 = not_chain[j + 3];       \
                                                                                \
-      add_expression(g0 & h, chain_size);                                      \
-      add_expression(g1 & h, chain_size);                                      \
-      add_expression(g2 & h, chain_size);                                      \
-      add_expression(g3 & h, chain_size);                                      \
+      add_expression(g0 & h, DERIVATION('&', j, chain_size - 1));              \
+      add_expression(g1 & h, DERIVATION('&', j + 1, chain_size - 1));          \
+      add_expression(g2 & h, DERIVATION('&', j + 2, chain_size - 1));          \
+      add_expression(g3 & h, DERIVATION('&', j + 3, chain_size - 1));          \
                                                                                \
-      add_expression(not_g0 & h, chain_size);                                  \
-      add_expression(not_g1 & h, chain_size);                                  \
-      add_expression(not_g2 & h, chain_size);                                  \
-      add_expression(not_g3 & h, chain_size);                                  \
+      add_expression(not_g0 & h, DERIVATION('<', j, chain_size - 1));          \
+      add_expression(not_g1 & h, DERIVATION('<', j + 1, chain_size - 1));      \
+      add_expression(not_g2 & h, DERIVATION('<', j + 2, chain_size - 1));      \
+      add_expression(not_g3 & h, DERIVATION('<', j + 3, chain_size - 1));      \
                                                                                \
-      add_expression(g0 & not_h, chain_size);                                  \
-      add_expression(g1 & not_h, chain_size);                                  \
-      add_expression(g2 & not_h, chain_size);                                  \
-      add_expression(g3 & not_h, chain_size);                                  \
+      add_expression(g0 & not_h, DERIVATION('>', j, chain_size - 1));          \
+      add_expression(g1 & not_h, DERIVATION('>', j + 1, chain_size - 1));      \
+      add_expression(g2 & not_h, DERIVATION('>', j + 2, chain_size - 1));      \
+      add_expression(g3 & not_h, DERIVATION('>', j + 3, chain_size - 1));      \
                                                                                \
-      add_expression(g0 ^ h, chain_size);                                      \
-      add_expression(g1 ^ h, chain_size);                                      \
-      add_expression(g2 ^ h, chain_size);                                      \
-      add_expression(g3 ^ h, chain_size);                                      \
+      add_expression(g0 ^ h, DERIVATION('^', j, chain_size - 1));              \
+      add_expression(g1 ^ h, DERIVATION('^', j + 1, chain_size - 1));          \
+      add_expression(g2 ^ h, DERIVATION('^', j + 2, chain_size - 1));          \
+      add_expression(g3 ^ h, DERIVATION('^', j + 3, chain_size - 1));          \
                                                                                \
-      add_expression(g0 | h, chain_size);                                      \
-      add_expression(g1 | h, chain_size);                                      \
-      add_expression(g2 | h, chain_size);                                      \
-      add_expression(g3 | h, chain_size);                                      \
+      add_expression(g0 | h, DERIVATION('|', j, chain_size - 1));              \
+      add_expression(g1 | h, DERIVATION('|', j + 1, chain_size - 1));          \
+      add_expression(g2 | h, DERIVATION('|', j + 2, chain_size - 1));          \
+      add_expression(g3 | h, DERIVATION('|', j + 3, chain_size - 1));          \
     }                                                                          \
                                                                                \
     _Pragma("loop unroll(full)") for (; j < chain_size - 1; j++) {             \
-      const uint32_t g = chain[j];                                             \
-      const uint32_t not_g = not_chain[j];                                     \
-      add_expression(g & h, chain_size);                                       \
-      add_expression(not_g & h, chain_size);                                   \
-      add_expression(g & not_h, chain_size);                                   \
-      add_expression(g ^ h, chain_size);                                       \
-      add_expression(g | h, chain_size);                                       \
+      const word_t g = chain[j];                                               \
+      const word_t not_g = not_chain[j];                                       \
+      add_expression(g & h, DERIVATION('&', j, chain_size - 1));               \
+      add_expression(not_g & h, DERIVATION('<', j, chain_size - 1));           \
+      add_expression(g & not_h, DERIVATION('>', j, chain_size - 1));           \
+      add_expression(g ^ h, DERIVATION('^', j, chain_size - 1));               \
+      add_expression(g | h, DERIVATION('|', j, chain_size - 1));               \
     }                                                                          \
                                                                                \
     expressions_size[chain_size] = _expr_size;                                 \
   }
 
+#if BOUND_PRUNING
+#define COUNT_BOUND_CUT(chain_size) stats_bound_cuts[chain_size]++;
+#else
+#define COUNT_BOUND_CUT(chain_size)
+#endif
+
+// every level only chooses expressions behind the index chosen before, and an
+// expression that is already in the list never gets added again, so a set of
+// chain functions can only be reached in the order in which its functions were
+// generated, i.e. no set is visited twice and there is nothing a transposition
+// table keyed on the set could skip
+#if !MULTI_TARGET_SETS
 #define FORWARD_DFS(CS, PREV_CS, NEXT_CS)                                      \
   GENERATE_NEW_EXPRESSIONS(CS, ADD_EXPRESSION)                                 \
   CAPTURE_STATS_CALL(CS)                                                       \
@@ -153,6 +403,7 @@ uint64_t stats_num_data_points[25] = {0};
   for (uint32_t i##CS = i##PREV_CS + 1; i##CS < limit_##CS; ++i##CS) {         \
     chain[CS] = expressions[i##CS];                                            \
     not_chain[CS] = ~chain[CS];                                                \
+    CHOOSE_DERIVATION(CS, i##CS)                                               \
     choices[CS] = i##CS;                                                       \
     const uint8_t is_target = unseen[chain[CS]] >> 1;                          \
                                                                                \
@@ -167,6 +418,8 @@ uint64_t stats_num_data_points[25] = {0};
     }                                                                          \
                                                                                \
     total_chains++;                                                            \
+    INSTRUMENT_NODE(CS)                                                        \
+    HEARTBEAT_CHOICE(CS, i##CS, limit_##CS)                                    \
                                                                                \
     if (!PLAN_MODE && CS + 1 == PRINT_PROGRESS_LENGTH) {                       \
       PRINT_PROGRESS(CS, i##CS);                                               \
@@ -176,14 +429,29 @@ uint64_t stats_num_data_points[25] = {0};
     if (CS < MAX_LENGTH - 1 && NEXT_CS >= MAX_LENGTH - NUM_TARGETS) {          \
       if (__builtin_expect(NEXT_CS + num_unfulfilled_targets == MAX_LENGTH,    \
                            1)) {                                               \
+        if (BOUND_PRUNING && !target_reachable<NEXT_CS>(                       \
+                                 chain, not_chain, unseen,                     \
+                                 num_unfulfilled_targets)) {                   \
+          COUNT_BOUND_CUT(CS);                                                 \
+          INSTRUMENT_BOUND_CUT(CS)                                             \
+          total_chains += limit_##CS - (i##CS + 1);                            \
+          INSTRUMENT_TARGET_CUT(CS)                                            \
+          num_unfulfilled_targets += is_target;                                \
+          i##CS += (is_target << 16);                                          \
+          continue;                                                            \
+        }                                                                      \
+                                                                               \
         uint32_t endgame_j = i##CS + 1;                                        \
                                                                                \
+        INSTRUMENT_ENDGAME_BEGIN(NEXT_CS)                                      \
         endgame<NEXT_CS>(chain, not_chain, unseen, expressions,                \
                          expressions_size, endgame_j,                          \
-                         num_unfulfilled_targets);                             \
+                         num_unfulfilled_targets, 2);                          \
+        INSTRUMENT_ENDGAME_END(NEXT_CS)                                        \
                                                                                \
         total_chains += endgame_j - (i##CS + 1);                               \
                                                                                \
+        INSTRUMENT_TARGET_CUT(CS)                                              \
         num_unfulfilled_targets += is_target;                                  \
         i##CS += (is_target << 16);                                            \
         continue;                                                              \
@@ -191,19 +459,111 @@ uint64_t stats_num_data_points[25] = {0};
     }
 
 #define BACKTRACK_DFS(CS, PREV_CS, NEXT_CS)                                    \
+  INSTRUMENT_TARGET_CUT(CS)                                                    \
   num_unfulfilled_targets += is_target;                                        \
   i##CS += (is_target << 16);                                                  \
   }                                                                            \
+  INSTRUMENT_LEVEL_DONE(CS, PREV_CS)                                           \
+                                                                               \
+  for (uint32_t i = expressions_size[PREV_CS]; i < expressions_size[CS];       \
+       i++) {                                                                  \
+    unseen[expressions[i]] |= 1;                                               \
+  }
+#else
+// the same with a count of unfulfilled targets per set, a target chosen at a
+// level ends the level only for its sets, chosen_CS, the later expressions
+// can't complete their chains anymore, live_CS are the sets that can still be
+// completed below the chain, every set runs its own endgame
+#define FORWARD_DFS(CS, PREV_CS, NEXT_CS)                                      \
+  GENERATE_NEW_EXPRESSIONS(CS, ADD_EXPRESSION)                                 \
+  CAPTURE_STATS_CALL(CS)                                                       \
+                                                                               \
+  const uint32_t limit_##CS = expressions_size[CS];                            \
+  uint8_t chosen_##CS = 0;                                                     \
+  for (uint32_t i##CS = i##PREV_CS + 1; i##CS < limit_##CS; ++i##CS) {         \
+    chain[CS] = expressions[i##CS];                                            \
+    not_chain[CS] = ~chain[CS];                                                \
+    CHOOSE_DERIVATION(CS, i##CS)                                               \
+    choices[CS] = i##CS;                                                       \
+    const uint8_t is_target = unseen[chain[CS]] >> 1;                          \
+    uint8_t live_##CS = live_##PREV_CS & ~chosen_##CS;                         \
+                                                                               \
+    if (PLAN_MODE) {                                                           \
+      if (CS >= CHUNK_START_LENGTH - 1) {                                      \
+        for (uint32_t j = start_chain_length; j <= CS; ++j) {                  \
+          printf("%d ", choices[j]);                                           \
+        }                                                                      \
+        printf("\n");                                                          \
+        continue;                                                              \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    total_chains++;                                                            \
+    INSTRUMENT_NODE(CS)                                                        \
+    HEARTBEAT_CHOICE(CS, i##CS, limit_##CS)                                    \
+                                                                               \
+    if (!PLAN_MODE && CS + 1 == PRINT_PROGRESS_LENGTH) {                       \
+      PRINT_PROGRESS(CS, i##CS);                                               \
+    }                                                                          \
+                                                                               \
+    FULFILL_TARGETS(is_target)                                                 \
+    if (CS < MAX_LENGTH - 1 && NEXT_CS >= MAX_LENGTH - NUM_TARGETS) {          \
+      for (uint32_t s = 0; s < NUM_TARGET_SETS; s++) {                         \
+        if (((live_##CS >> s) & 1) &&                                          \
+            NEXT_CS + num_unfulfilled_targets[s] == MAX_LENGTH) {              \
+          live_##CS &= ~(1 << s);                                              \
+          uint32_t endgame_j = i##CS + 1;                                      \
+                                                                               \
+          INSTRUMENT_ENDGAME_BEGIN(NEXT_CS)                                    \
+          endgame<NEXT_CS>(chain, not_chain, unseen, expressions,              \
+                           expressions_size, endgame_j,                        \
+                           num_unfulfilled_targets[s], 2 << s);                \
+          INSTRUMENT_ENDGAME_END(NEXT_CS)                                      \
+                                                                               \
+          total_chains += endgame_j - (i##CS + 1);                             \
+        }                                                                      \
+      }                                                                        \
+                                                                               \
+      if (!live_##CS) {                                                        \
+        UNFULFILL_TARGETS(is_target)                                           \
+        chosen_##CS |= is_target;                                              \
+        if (!(live_##PREV_CS & ~chosen_##CS)) {                                \
+          INSTRUMENT_LEVEL_CUT(CS)                                             \
+          break;                                                               \
+        }                                                                      \
+        continue;                                                              \
+      }                                                                        \
+    }
+
+#define BACKTRACK_DFS(CS, PREV_CS, NEXT_CS)                                    \
+  UNFULFILL_TARGETS(is_target)                                                 \
+  chosen_##CS |= is_target;                                                    \
+  if (!(live_##PREV_CS & ~chosen_##CS)) {                                      \
+    INSTRUMENT_LEVEL_CUT(CS)                                                   \
+    break;                                                                     \
+  }                                                                            \
+  }                                                                            \
+  INSTRUMENT_LEVEL_DONE(CS, PREV_CS)                                           \
                                                                                \
   for (uint32_t i = expressions_size[PREV_CS]; i < expressions_size[CS];       \
        i++) {                                                                  \
     unseen[expressions[i]] |= 1;                                               \
   }
+#endif
 
-void print_chain(const uint32_t *chain, const uint32_t chain_size) {
+void print_chain(const word_t *chain, const uint32_t chain_size,
+                 const word_t *targets) {
   printf("chain (%d):\n", chain_size);
   for (uint32_t i = 0; i < chain_size; i++) {
     printf("x%d", i + 1);
+#if RECORD_DERIVATIONS
+    // only the derivation that generated the function
+    const uint32_t derivation = chain_derivations[i];
+    if (derivation & 0xff) {
+      printf(" = x%d %c x%d", ((derivation >> 8) & 0xff) + 1, derivation & 0xff,
+             (derivation >> 16) + 1);
+    }
+#else
     for (uint32_t j = 0; j < i; j++) {
       for (uint32_t k = j + 1; k < i; k++) {
         char op = 0;
@@ -224,10 +584,11 @@ void print_chain(const uint32_t *chain, const uint32_t chain_size) {
         printf(" = x%d %c x%d", j + 1, op, k + 1);
       }
     }
+#endif
     printf(" = %s", std::bitset<N>(chain[i]).to_string().c_str());
     uint8_t is_target = 0;
     for (uint32_t i = 0; i < NUM_TARGETS; i++) {
-      if (chain[i] == TARGETS[i]) {
+      if (chain[i] == targets[i]) {
         is_target = 1;
         break;
       }
@@ -239,39 +600,271 @@ void print_chain(const uint32_t *chain, const uint32_t chain_size) {
   }
 }
 
+#if COLLECT_ALL
+static_assert(MAX_LENGTH <= MAX_SOLUTION_LENGTH, "chains don't fit the record");
+
+FILE *solutions_file = nullptr;
+SolutionsHeader solutions_header;
+// the sorted functions and the target set of the chunk's chains
+std::set<std::vector<word_t>> chunk_solutions;
+uint64_t stats_solutions = 0;
+uint64_t stats_duplicate_solutions = 0;
+
+void collect_chain(const word_t *chain, const uint32_t chain_size,
+                   const uint32_t target_set) {
+  std::vector<word_t> key(chain, chain + chain_size);
+  std::sort(key.begin(), key.end());
+  key.push_back(target_set);
+  if (!chunk_solutions.insert(key).second) {
+    stats_duplicate_solutions++;
+    return;
+  }
+  stats_solutions++;
+
+  SolutionRecord record;
+  memset(&record, 0, sizeof(record));
+  record.length = chain_size;
+  record.num_inputs = NUM_INPUTS;
+  record.target_set = target_set;
+  for (uint32_t i = 0; i < chain_size; i++) {
+    record.functions[i] = chain[i];
+#if RECORD_DERIVATIONS
+    record.ops[i] = chain_derivations[i] & 0xff;
+    record.operands[i][0] = (chain_derivations[i] >> 8) & 0xff;
+    record.operands[i][1] = chain_derivations[i] >> 16;
+#else
+    // the first derivation, in the same order as print_chain
+    for (uint32_t j = 0; j < i && !record.ops[i]; j++) {
+      for (uint32_t k = j + 1; k < i; k++) {
+        char op = 0;
+        if (chain[i] == (chain[j] & chain[k])) {
+          op = '&';
+        } else if (chain[i] == (chain[j] | chain[k])) {
+          op = '|';
+        } else if (chain[i] == (chain[j] ^ chain[k])) {
+          op = '^';
+        } else if (chain[i] == ((~chain[j]) & chain[k])) {
+          op = '<';
+        } else if (chain[i] == (chain[j] & (~chain[k]))) {
+          op = '>';
+        } else {
+          continue;
+        }
+
+        record.ops[i] = op;
+        record.operands[i][0] = j;
+        record.operands[i][1] = k;
+        break;
+      }
+    }
+#endif
+  }
+  uint8_t bytes[sizeof(SolutionRecord)];
+  pack_solution(record, solutions_header, bytes);
+  fwrite(bytes, solutions_header.record_size, 1, solutions_file);
+}
+#endif
+
+#if !MULTI_TARGET_SETS
+// lower bound for the remaining expressions is the number of unfulfilled
+// targets, plus one if none of them can be the next expression, so in the
+// endgame, where only targets are left to add, the branch can be cut
 template <int CS>
 __attribute__((always_inline)) bool
-endgame(uint32_t *chain, uint32_t *not_chain, uint8_t *unseen,
-        uint32_t *expressions, uint32_t *expressions_size, uint32_t &j,
-        uint32_t num_unfulfilled) {
+target_reachable(const word_t *chain, const word_t *not_chain,
+                 ConstUnseenRef unseen, const uint32_t num_unfulfilled) {
+  // generated targets that are not in the chain yet, the targets in the chain
+  // were all generated before they got chosen
+  uint32_t generated = 0;
+  for (uint32_t i = 0; i < NUM_TARGETS; i++) {
+    generated += unseen[TARGETS[i]] == 2;
+  }
+  if (generated > NUM_TARGETS - num_unfulfilled) {
+    return true;
+  }
+
+  // the expressions with the last chain element haven't been generated yet
+  const word_t h = chain[CS - 1];
+  const word_t not_h = not_chain[CS - 1];
+  for (uint32_t j = 0; j < CS - 1; j++) {
+    const word_t g = chain[j];
+    const word_t not_g = not_chain[j];
+    if ((unseen[g & h] == 3) | (unseen[not_g & h] == 3) |
+        (unseen[g & not_h] == 3) | (unseen[g ^ h] == 3) |
+        (unseen[g | h] == 3)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+#endif
+
+#if SIMD_ENDGAME
+typedef word_t vec4
+    __attribute__((vector_size(4 * sizeof(word_t)), may_alias));
+
+// only targets are added in the endgame, so the new expressions are compared
+// four at a time with the targets that haven't been generated yet instead of
+// looking up each of them in unseen, a group with a match is added in the same
+// order as GENERATE_NEW_EXPRESSIONS(CS, ADD_EXPRESSION_TARGET) would
+template <int CS>
+__attribute__((always_inline)) void
+generate_targets(const word_t *chain, const word_t *not_chain,
+                 UnseenRef unseen, word_t *expressions,
+                 uint32_t *expressions_size) {
+  uint32_t _expr_size = expressions_size[CS - 1];
+  const word_t h = chain[CS - 1];
+  const word_t not_h = not_chain[CS - 1];
+
+  // never matches, expressions are smaller than 1 << (N - 1)
+  word_t pending[NUM_TARGETS];
+  uint32_t num_pending = 0;
+  for (uint32_t i = 0; i < NUM_TARGETS; i++) {
+    const bool is_pending = unseen[TARGETS[i]] == 3;
+    pending[i] = is_pending ? TARGETS[i] : ~(word_t)0;
+    num_pending += is_pending;
+  }
+
+  uint32_t j = 0;
+  if (!num_pending) {
+    goto done;
+  }
+
+  for (; j < CS - 4; j += 4) {
+    const vec4 g = *(const vec4 *)(chain + j);
+    const vec4 not_g = *(const vec4 *)(not_chain + j);
+    const vec4 e0 = g & h, e1 = not_g & h, e2 = g & not_h, e3 = g ^ h,
+               e4 = g | h;
+
+    auto hit = (e0 == pending[0]) | (e1 == pending[0]) | (e2 == pending[0]) |
+               (e3 == pending[0]) | (e4 == pending[0]);
+    for (uint32_t k = 1; k < NUM_TARGETS; k++) {
+      hit |= (e0 == pending[k]) | (e1 == pending[k]) | (e2 == pending[k]) |
+             (e3 == pending[k]) | (e4 == pending[k]);
+    }
+
+    if (__builtin_expect(hit[0] | hit[1] | hit[2] | hit[3], 0)) {
+      for (uint32_t k = 0; k < 4; k++) {
+        ADD_EXPRESSION_TARGET(e0[k], DERIVATION('&', j + k, CS - 1))
+      }
+      for (uint32_t k = 0; k < 4; k++) {
+        ADD_EXPRESSION_TARGET(e1[k], DERIVATION('<', j + k, CS - 1))
+      }
+      for (uint32_t k = 0; k < 4; k++) {
+        ADD_EXPRESSION_TARGET(e2[k], DERIVATION('>', j + k, CS - 1))
+      }
+      for (uint32_t k = 0; k < 4; k++) {
+        ADD_EXPRESSION_TARGET(e3[k], DERIVATION('^', j + k, CS - 1))
+      }
+      for (uint32_t k = 0; k < 4; k++) {
+        ADD_EXPRESSION_TARGET(e4[k], DERIVATION('|', j + k, CS - 1))
+      }
+
+      // all targets that can still be added are there
+      if (_expr_size - expressions_size[CS - 1] == num_pending) {
+        goto done;
+      }
+    }
+  }
+
+  for (; j < CS - 1; j++) {
+    const word_t g = chain[j];
+    const word_t not_g = not_chain[j];
+    ADD_EXPRESSION_TARGET(g & h, DERIVATION('&', j, CS - 1));
+    ADD_EXPRESSION_TARGET(not_g & h, DERIVATION('<', j, CS - 1));
+    ADD_EXPRESSION_TARGET(g & not_h, DERIVATION('>', j, CS - 1));
+    ADD_EXPRESSION_TARGET(g ^ h, DERIVATION('^', j, CS - 1));
+    ADD_EXPRESSION_TARGET(g | h, DERIVATION('|', j, CS - 1));
+  }
+
+done:
+  expressions_size[CS] = _expr_size;
+}
+
+typedef word_t unaligned_vec4 __attribute__((
+    vector_size(4 * sizeof(word_t)), aligned(sizeof(word_t)), may_alias));
+
+// the index of the next target in the expressions, or limit, the chain's
+// targets are all before the index, so any target is one that's left
+__attribute__((always_inline)) uint32_t next_target(const word_t *expressions,
+                                                    ConstUnseenRef unseen,
+                                                    uint32_t j,
+                                                    const uint32_t limit) {
+  for (; j + 4 <= limit; j += 4) {
+    const unaligned_vec4 e = *(const unaligned_vec4 *)(expressions + j);
+    auto hit = e == TARGETS[0];
+    for (uint32_t k = 1; k < NUM_TARGETS; k++) {
+      hit |= e == TARGETS[k];
+    }
+    if (__builtin_expect(hit[0] | hit[1] | hit[2] | hit[3], 0)) {
+      break;
+    }
+  }
+
+  while (j < limit && !(unseen[expressions[j]] & 2)) {
+    j++;
+  }
+  return j;
+}
+#endif
+
+template <int CS>
+__attribute__((always_inline)) bool
+endgame(word_t *chain, word_t *not_chain, UnseenRef unseen,
+        word_t *expressions, uint32_t *expressions_size, uint32_t &j,
+        uint32_t num_unfulfilled, const uint8_t target_flag) {
   if constexpr (CS >= MAX_LENGTH) {
     return false;
   } else {
+#if SIMD_ENDGAME
+    generate_targets<CS>(chain, not_chain, unseen, expressions,
+                         expressions_size);
+#else
     GENERATE_NEW_EXPRESSIONS(CS, ADD_EXPRESSION_TARGET)
+#endif
 
     bool found_all = false;
     const uint32_t limit = expressions_size[CS];
     while (j < limit) {
-      if (__builtin_expect(unseen[expressions[j]] & 2, 0)) {
+      if (__builtin_expect(unseen[expressions[j]] & target_flag, 0)) {
         chain[CS] = expressions[j];
         not_chain[CS] = ~chain[CS];
+        CHOOSE_DERIVATION(CS, j)
         j++;
 
         if (__builtin_expect(num_unfulfilled == 1, 0)) {
-          print_chain(chain, CS + 1);
+          INSTRUMENT_FOUND
+#if COLLECT_ALL
+          collect_chain(chain, CS + 1, __builtin_ctz(target_flag) - 1);
+          continue;
+#else
+#if MULTI_TARGET_SETS
+          const uint32_t set = __builtin_ctz(target_flag) - 1;
+          printf("target set: %d\n", set);
+          print_chain(chain, CS + 1, TARGET_SETS[set]);
+#else
+          print_chain(chain, CS + 1, TARGETS);
+#endif
           found_all = true;
           break;
+#endif
         }
 
         if (endgame<CS + 1>(chain, not_chain, unseen, expressions,
-                            expressions_size, j, num_unfulfilled - 1)) {
+                            expressions_size, j, num_unfulfilled - 1,
+                            target_flag)) {
           found_all = true;
           break;
         }
         // j already advanced by manual j++ and recursive call
         // no extra increment
       } else {
+#if SIMD_ENDGAME
+        j = next_target(expressions, unseen, j + 1, limit);
+#else
         j++;
+#endif
       }
     }
 
@@ -283,9 +876,180 @@ endgame(uint32_t *chain, uint32_t *not_chain, uint8_t *unseen,
   }
 }
 
-void on_exit() {
+void print_header() {
+  printf("N = %d, MAX_LENGTH: %d, CAPTURE_STATS: %d", N, MAX_LENGTH,
+         CAPTURE_STATS);
+#if BOUND_PRUNING
+  printf(", BOUND_PRUNING: %d", BOUND_PRUNING);
+#endif
+#if COLLECT_ALL
+  printf(", COLLECT_ALL: %d", COLLECT_ALL);
+#endif
+#if INSTRUMENT
+  printf(", INSTRUMENT: %d", INSTRUMENT);
+#endif
+  printf("\n");
+#if MULTI_TARGET_SETS
+  for (uint32_t s = 0; s < NUM_TARGET_SETS; s++) {
+    printf("target set %d:\n", s);
+    for (uint32_t i = 0; i < NUM_TARGETS && TARGET_SETS[s][i]; i++) {
+      printf("  %s\n", std::bitset<N>(TARGET_SETS[s][i]).to_string().c_str());
+    }
+  }
+#else
+  printf("%d targets:\n", NUM_TARGETS);
+  for (uint32_t i = 0; i < NUM_TARGETS; i++) {
+    printf("  %s\n", std::bitset<N>(TARGETS[i]).to_string().c_str());
+  }
+#endif
+  fflush(stdout);
+}
+
+// clears the counters of the last chunk, the initial branch is the same for
+// all chunks and stays
+void reset_chunk_stats() {
+  total_chains = 0;
+
+#if BOUND_PRUNING
+  memset(stats_bound_cuts, 0, sizeof(stats_bound_cuts));
+#endif
+
+#if CAPTURE_STATS
+  for (uint32_t i = start_chain_length; i < 25; i++) {
+    stats_total_num_expressions[i] = 0;
+    stats_min_num_expressions[i] = UNDEFINED;
+    stats_max_num_expressions[i] = 0;
+    stats_num_data_points[i] = 0;
+  }
+#endif
+
+#if COLLECT_ALL
+  chunk_solutions.clear();
+  stats_solutions = 0;
+  stats_duplicate_solutions = 0;
+#endif
+
+#if INSTRUMENT
+  // the counters before the chunk are dropped, restoring the prefix counts
+  // for the level before the chunk's first one
+  instrument_switch(CHUNK_START_LENGTH - 1);
+  memset(instrument_nodes, 0, sizeof(instrument_nodes));
+  memset(instrument_endgames, 0, sizeof(instrument_endgames));
+  memset(instrument_endgame_successes, 0,
+         sizeof(instrument_endgame_successes));
+  memset(instrument_pruned, 0, sizeof(instrument_pruned));
+  memset(instrument_perf, 0, sizeof(instrument_perf));
+#endif
+}
+
+#if INSTRUMENT
+void print_instrument_value(const uint32_t c, const uint64_t value) {
+  if (perf_counters.available[c]) {
+    printf(" %16" PRIu64, value);
+  } else {
+    printf(" %16s", "-");
+  }
+}
+
+void print_instrument_json_value(const uint32_t c, const uint64_t value) {
+  if (perf_counters.available[c]) {
+    fprintf(instrument_file, ", \"%s\": %" PRIu64, PERF_COUNTER_NAMES[c],
+            value);
+  } else {
+    fprintf(instrument_file, ", \"%s\": null", PERF_COUNTER_NAMES[c]);
+  }
+}
+
+void print_instrument() {
+  instrument_switch(instrument_level);
+
+  printf("search at chain length:\n");
+  printf("                nodes         endgames        successes           "
+         "pruned\n");
+  for (uint32_t i = start_chain_length; i < 25; i++) {
+    if (instrument_nodes[i] || instrument_endgames[i] ||
+        instrument_pruned[i]) {
+      printf("%2d: %16" PRIu64 " %16" PRIu64 " %16" PRIu64 " %16" PRIu64 "\n",
+             i, instrument_nodes[i], instrument_endgames[i],
+             instrument_endgame_successes[i], instrument_pruned[i]);
+    }
+  }
+
+  // the first row is the restored prefix, the last one includes the longer
+  // chains
+  printf("hardware counters at chain length:\n");
+  printf("          task clock ns           cycles     instructions       "
+         "L1D misses       LLC misses    branch misses\n");
+  for (uint32_t i = CHUNK_START_LENGTH - 1; i <= INSTRUMENT_PERF_DEPTH; i++) {
+    if (i < CHUNK_START_LENGTH) {
+      printf("prefix");
+    } else if (i == INSTRUMENT_PERF_DEPTH) {
+      printf("%2d-%2d:", i, MAX_LENGTH);
+    } else {
+      printf("%6d", i);
+    }
+    for (uint32_t c = 0; c < NUM_PERF_COUNTERS; c++) {
+      print_instrument_value(c, instrument_perf[i][c]);
+    }
+    printf("\n");
+  }
+
+  fprintf(instrument_file, "{\"chunk\": \"%s\", \"total_chains\": %" PRIu64,
+          instrument_chunk.c_str(), total_chains);
+  fprintf(instrument_file, ", \"levels\": [");
+  bool first = true;
+  for (uint32_t i = start_chain_length; i < 25; i++) {
+    if (instrument_nodes[i] || instrument_endgames[i] ||
+        instrument_pruned[i]) {
+      fprintf(instrument_file,
+              "%s{\"length\": %d, \"nodes\": %" PRIu64
+              ", \"endgames\": %" PRIu64 ", \"endgame_successes\": %" PRIu64
+              ", \"pruned\": %" PRIu64 "}",
+              first ? "" : ", ", i, instrument_nodes[i],
+              instrument_endgames[i], instrument_endgame_successes[i],
+              instrument_pruned[i]);
+      first = false;
+    }
+  }
+  fprintf(instrument_file, "], \"perf\": [");
+  for (uint32_t i = CHUNK_START_LENGTH - 1; i <= INSTRUMENT_PERF_DEPTH; i++) {
+    // the range of chain lengths, the prefix is everything before the chunk
+    const uint32_t from = i < CHUNK_START_LENGTH ? start_chain_length : i;
+    const uint32_t to = i == INSTRUMENT_PERF_DEPTH ? MAX_LENGTH : i;
+    fprintf(instrument_file, "%s{\"from\": %d, \"to\": %d",
+            i == CHUNK_START_LENGTH - 1 ? "" : ", ", from, to);
+    for (uint32_t c = 0; c < NUM_PERF_COUNTERS; c++) {
+      print_instrument_json_value(c, instrument_perf[i][c]);
+    }
+    fprintf(instrument_file, "}");
+  }
+  fprintf(instrument_file, "]}\n");
+  fflush(instrument_file);
+}
+#endif
+
+void print_summary() {
   printf("total chains: %" PRIu64 "\n", total_chains);
 
+#if COLLECT_ALL
+  printf("solutions: %" PRIu64 ", duplicates: %" PRIu64 "\n", stats_solutions,
+         stats_duplicate_solutions);
+  fflush(solutions_file);
+#endif
+
+#if INSTRUMENT
+  print_instrument();
+#endif
+
+#if BOUND_PRUNING
+  printf("bound cuts at chain length:\n");
+  for (int i = start_chain_length; i < MAX_LENGTH; i++) {
+    if (stats_bound_cuts[i]) {
+      printf("%2d: %16" PRIu64 "\n", i, stats_bound_cuts[i]);
+    }
+  }
+#endif
+
 #if CAPTURE_STATS
   printf("new expressions at chain length:\n");
   printf("                   n                       sum              avg     "
@@ -313,20 +1077,170 @@ void on_exit() {
 #endif
 }
 
+void on_exit() {
+  if (chunk_running) {
+    print_summary();
+    if (chunk_wrapped) {
+      print_chunk_end(chunk_timer);
+    }
+  }
+}
+
 void signal_handler(int signal) {
   printf("Interrupted.\n");
   exit(signal);
 }
 
+#if !PLAN_MODE
+// like ADD_EXPRESSION, without the derivations, which are the search's
+#define ADD_SHARD_EXPRESSION(value, derivation)                                \
+  {                                                                            \
+    const uint8_t u = unseen[value];                                           \
+    expressions[_expr_size] = value;                                           \
+    _expr_size += u & 1;                                                       \
+    unseen[value] = u & TARGET_FLAGS;                                          \
+  }
+
+// the chunks of --shard, see src/chunks.h, in the order of full-search-plan,
+// levels up to the chunk's are generated like in the search and a target ends
+// its level for its sets, the depth is at most CHUNK_START_LENGTH
+struct ShardEnumerator {
+  Shard shard;
+  Unseen unseen;
+  word_t chain[CHUNK_START_LENGTH];
+  word_t not_chain[CHUNK_START_LENGTH];
+  word_t expressions[1000];
+  uint32_t expressions_size[CHUNK_START_LENGTH];
+  uint32_t choices[CHUNK_START_LENGTH];
+  // the target sets whose targets a level chose, and those still open
+  uint8_t chosen[CHUNK_START_LENGTH];
+  uint8_t live[CHUNK_START_LENGTH];
+  uint32_t level;
+  // of the prefixes up to the depth
+  uint64_t position = 0;
+  bool owned = false;
+
+  void start(const Shard &s) {
+    shard = s;
+    if (!shard.depth) {
+      shard.depth = CHUNK_START_LENGTH;
+    }
+
+    fill_unseen(unseen, 1);
+#if MULTI_TARGET_SETS
+    for (uint32_t s = 0; s < NUM_TARGET_SETS; s++) {
+      for (uint32_t i = 0; i < NUM_TARGETS; i++) {
+        if (TARGET_SETS[s][i]) {
+          unseen[TARGET_SETS[s][i]] |= 2 << s;
+        }
+      }
+    }
+#else
+    for (uint32_t i = 0; i < NUM_TARGETS; i++) {
+      unseen[TARGETS[i]] |= 2;
+    }
+#endif
+    unseen[0] = 0;
+    for (uint32_t i = 0; i < NUM_INPUTS; i++) {
+      chain[i] = input_truth_table<word_t>(i, NUM_INPUTS, N);
+      not_chain[i] = ~chain[i];
+      unseen[chain[i]] = 0;
+    }
+
+    // the same first expressions as main's
+    uint32_t _expr_size = 0;
+    for (uint32_t k = 1; k < NUM_INPUTS - 1; k++) {
+      for (uint32_t j = 0; j < k; j++) {
+        ADD_SHARD_EXPRESSION(chain[j] & chain[k], 0)
+        ADD_SHARD_EXPRESSION(chain[j] & not_chain[k], 0)
+        ADD_SHARD_EXPRESSION(chain[j] ^ chain[k], 0)
+        ADD_SHARD_EXPRESSION(chain[j] | chain[k], 0)
+        ADD_SHARD_EXPRESSION(not_chain[j] & chain[k], 0)
+      }
+    }
+    expressions_size[NUM_INPUTS - 1] = _expr_size;
+    choices[NUM_INPUTS - 1] = 0xffffffff;
+    live[NUM_INPUTS - 1] = TARGET_FLAGS >> 1;
+    level = NUM_INPUTS - 1;
+    enter();
+  }
+
+  void enter() {
+    level++;
+    GENERATE_NEW_EXPRESSIONS(level, ADD_SHARD_EXPRESSION)
+    choices[level] = choices[level - 1];
+    chosen[level] = 0;
+  }
+
+  // after the subtree of the level's choice, a target ends the level for its
+  // sets like in the DFS
+  void finish_choice() {
+    chosen[level] |= unseen[chain[level]] >> 1;
+    if (!(live[level - 1] & ~chosen[level])) {
+      choices[level] = expressions_size[level];
+    }
+  }
+
+  void leave() {
+    for (uint32_t i = expressions_size[level - 1]; i < expressions_size[level];
+         i++) {
+      unseen[expressions[i]] |= 1;
+    }
+    level--;
+    if (level >= NUM_INPUTS) {
+      finish_choice();
+    }
+  }
+
+  bool next(ChunkArgs &args) {
+    while (level >= NUM_INPUTS) {
+      const uint32_t i = ++choices[level];
+      if (i >= expressions_size[level]) {
+        leave();
+        continue;
+      }
+      chain[level] = expressions[i];
+      not_chain[level] = ~chain[level];
+      if (level + 1 == shard.depth) {
+        owned = shard.owns(position++);
+      }
+
+      if (level == CHUNK_START_LENGTH - 1) {
+        if (!owned) {
+          continue;
+        }
+        args.clear();
+        for (uint32_t j = NUM_INPUTS; j <= level; j++) {
+          args.push_back(std::to_string(choices[j]));
+        }
+        return true;
+      }
+      if (level + 1 == shard.depth && !owned) {
+        finish_choice();
+        continue;
+      }
+      live[level] = live[level - 1] & ~chosen[level];
+      enter();
+    }
+    return false;
+  }
+};
+ShardEnumerator shard_enumerator;
+#endif
+
 int main(int argc, char *argv[]) {
+#if MULTI_TARGET_SETS
+  uint32_t num_unfulfilled_targets[NUM_TARGET_SETS] = {0};
+#else
   uint32_t num_unfulfilled_targets = NUM_TARGETS;
+#endif
   uint32_t start_indices_size __attribute__((aligned(64))) = 0;
   uint16_t start_indices[100] __attribute__((aligned(64))) = {0};
   uint32_t choices[30] __attribute__((aligned(64)));
-  uint8_t unseen[SIZE] __attribute__((aligned(64)));
-  uint32_t chain[25] __attribute__((aligned(64)));
-  uint32_t not_chain[25] __attribute__((aligned(64)));
-  uint32_t expressions[1000] __attribute__((aligned(64)));
+  Unseen unseen __attribute__((aligned(64)));
+  word_t chain[25] __attribute__((aligned(64)));
+  word_t not_chain[25] __attribute__((aligned(64)));
+  word_t expressions[1000] __attribute__((aligned(64)));
   uint32_t expressions_size[25] __attribute__((aligned(64)));
   uint32_t tmp_chain_size;
   uint32_t generated_chain_size;
@@ -338,52 +1252,98 @@ int main(int argc, char *argv[]) {
   signal(SIGTERM, signal_handler);
 #endif
 
-  chain[0] = 0b0000000011111111 >> (16 - N);
-  chain[1] = 0b0000111100001111 >> (16 - N);
-  chain[2] = 0b0011001100110011 >> (16 - N);
-  chain[3] = 0b0101010101010101 >> (16 - N);
-  not_chain[0] = ~chain[0];
-  not_chain[1] = ~chain[1];
-  not_chain[2] = ~chain[2];
-  not_chain[3] = ~chain[3];
-  uint32_t chain_size = 4;
+  for (uint32_t i = 0; i < NUM_INPUTS; i++) {
+    chain[i] = input_truth_table<word_t>(i, NUM_INPUTS, N);
+    not_chain[i] = ~chain[i];
+  }
+  uint32_t chain_size = NUM_INPUTS;
   start_chain_length = chain_size;
 
 #if !PLAN_MODE
-  for (uint32_t i = 0; i < chain_size; i++) {
-    start_indices[start_indices_size++] = 0;
+  // one or more progress vectors, e.g 5 2 9, commas will be ignored: 5, 2, 9
+  int first_arg = 1;
+#if COLLECT_ALL
+  const char *solutions_path = "solutions.bin";
+  if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+    solutions_path = argv[2];
+    first_arg = 3;
   }
-
-  // read the progress vector, e.g 5 2 9, commas will be ignored: 5, 2, 9
-  for (uint32_t i = 1; i < argc; i++) {
-    start_indices[start_indices_size++] = atoi(argv[i]);
+  solutions_file =
+      open_solutions(solutions_path, N, MAX_LENGTH, solutions_header);
+  if (solutions_file == nullptr) {
+    return -1;
   }
-
-  if (start_indices_size != CHUNK_START_LENGTH) {
-    printf("expected %d integers as chunk prefix\n",
-           CHUNK_START_LENGTH - chain_size);
+#endif
+#if INSTRUMENT
+  const char *instrument_path = "instrument.json";
+  if (argc > first_arg + 1 && strcmp(argv[first_arg], "-i") == 0) {
+    instrument_path = argv[first_arg + 1];
+    first_arg += 2;
+  }
+  instrument_file = fopen(instrument_path, "a");
+  if (instrument_file == nullptr) {
+    printf("couldn't open instrument file %s\n", instrument_path);
     return -1;
   }
+  perf_counters.open();
 #endif
+  ChunkSource chunk_source;
+  while (heartbeat.parse_arg(argc, argv, first_arg) ||
+         chunk_source.worker.parse_arg(argc, argv, first_arg) ||
+         chunk_source.shard.parse_arg(argc, argv, first_arg)) {
+  }
+  heartbeat.start(sample_heartbeat);
+
+  if (!chunk_source.read(argc, argv, first_arg)) {
+    return -1;
+  }
+  if (chunk_source.shard.enabled()) {
+    if (chunk_source.shard.depth > CHUNK_START_LENGTH ||
+        (chunk_source.shard.depth && chunk_source.shard.depth <= chain_size)) {
+      printf("the shard depth must be in %d..%d\n", chain_size + 1,
+             CHUNK_START_LENGTH);
+      return -1;
+    }
+    shard_enumerator.start(chunk_source.shard);
+    chunk_source.enumerate = [](ChunkArgs &args) {
+      return shard_enumerator.next(args);
+    };
+  }
+  chunk_wrapped = chunk_source.list.wrapped;
 
-  for (uint32_t i = 0; i < SIZE; i++) {
-    // flip the logic: 1 means unseen, 0 unseen, that'll avoid one operation
-    // when setting this flag
-    unseen[i] = 1;
+  for (const auto &args : chunk_source.list.chunks) {
+    if (chain_size + args.size() != CHUNK_START_LENGTH) {
+      printf("expected %d integers as chunk prefix\n",
+             CHUNK_START_LENGTH - chain_size);
+      return -1;
+    }
   }
+  start_indices_size = CHUNK_START_LENGTH;
+#endif
+
+  // flip the logic: 1 means unseen, 0 unseen, that'll avoid one operation
+  // when setting this flag
+  fill_unseen(unseen, 1);
 
+#if MULTI_TARGET_SETS
+  for (uint32_t s = 0; s < NUM_TARGET_SETS; s++) {
+    for (uint32_t i = 0; i < NUM_TARGETS; i++) {
+      if (TARGET_SETS[s][i]) {
+        unseen[TARGET_SETS[s][i]] |= 2 << s;
+        num_unfulfilled_targets[s]++;
+      }
+    }
+  }
+#else
   for (uint32_t i = 0; i < NUM_TARGETS; i++) {
     unseen[TARGETS[i]] |= 2;
   }
+#endif
 
 #if PLAN_MODE != 1
-  printf("N = %d, MAX_LENGTH: %d, CAPTURE_STATS: %d\n", N, MAX_LENGTH,
-         CAPTURE_STATS);
-  printf("%d targets:\n", NUM_TARGETS);
-  for (uint32_t i = 0; i < NUM_TARGETS; i++) {
-    printf("  %s\n", std::bitset<N>(TARGETS[i]).to_string().c_str());
+  if (!chunk_wrapped) {
+    print_header();
   }
-  fflush(stdout);
 #endif
 
 #if CAPTURE_STATS
@@ -398,17 +1358,17 @@ int main(int argc, char *argv[]) {
   chain_size--;
   uint32_t _expr_size = 0;
   for (uint32_t k = 1; k < chain_size; k++) {
-    const uint32_t h = chain[k];
-    const uint32_t not_h = not_chain[k];
+    const word_t h = chain[k];
+    const word_t not_h = not_chain[k];
     for (uint32_t j = 0; j < k; j++) {
-      const uint32_t g = chain[j];
-      const uint32_t not_g = not_chain[j];
+      const word_t g = chain[j];
+      const word_t not_g = not_chain[j];
 
-      ADD_EXPRESSION(g & h, chain_size)
-      ADD_EXPRESSION(g & not_h, chain_size)
-      ADD_EXPRESSION(g ^ h, chain_size)
-      ADD_EXPRESSION(g | h, chain_size)
-      ADD_EXPRESSION(not_g & h, chain_size)
+      ADD_EXPRESSION(g & h, DERIVATION('&', j, k))
+      ADD_EXPRESSION(g & not_h, DERIVATION('>', j, k))
+      ADD_EXPRESSION(g ^ h, DERIVATION('^', j, k))
+      ADD_EXPRESSION(g | h, DERIVATION('|', j, k))
+      ADD_EXPRESSION(not_g & h, DERIVATION('<', j, k))
     }
   }
   expressions_size[chain_size] = _expr_size;
@@ -418,47 +1378,108 @@ int main(int argc, char *argv[]) {
   chain_size++;
 
 #if PLAN_MODE
+  // the plan's levels start after the 4 inputs
+  static_assert(NUM_INPUTS == 4, "plan mode needs N <= 16");
   uint32_t i3 = 0xffffffff;
+#if MULTI_TARGET_SETS
+  const uint8_t live_3 = (1 << NUM_TARGET_SETS) - 1;
+#endif
 #else
-  // restore progress
-  while (chain_size < start_indices_size) {
-    GENERATE_NEW_EXPRESSIONS(chain_size, ADD_EXPRESSION)
-    // this can be used to output the first expressions with the index,
-    // which allows some custom order for promising expressions
-    // if (chain_size == 4) {
-    //   for (int m = 0; m < expressions_size[4]; m++) {
-    //     uint32_t e = expressions[m];
-    //     printf("%d: ", m);
-    //     for (uint32_t j = 0; j < 4; j++) {
-    //       for (uint32_t k = j + 1; k < 4; k++) {
-    //         char op = 0;
-    //         if (e == (chain[j] & chain[k])) {
-    //           op = '&';
-    //         } else if (e == (chain[j] | chain[k])) {
-    //           op = '|';
-    //         } else if (e == (chain[j] ^ chain[k])) {
-    //           op = '^';
-    //         } else if (e == ((~chain[j]) & chain[k])) {
-    //           op = '<';
-    //         } else if (e == (chain[j] & (~chain[k]))) {
-    //           op = '>';
-    //         } else {
-    //           continue;
-    //         }
-    //         printf(" = x%d %c x%d", j + 1, op, k + 1);
-    //       }
-    //     }
-    //     printf("\n");
-    //   }
-    // }
-    choices[chain_size] = start_indices[chain_size];
-    chain[chain_size] = expressions[choices[chain_size]];
-    not_chain[chain_size] = ~chain[chain_size];
-    num_unfulfilled_targets -= unseen[chain[chain_size]] >> 1;
-    chain_size++;
-  }
-
-  uint32_t i8 = choices[chain_size - 1];
+  for (ChunkArgs args; chunk_source.next(args);) {
+    // the coordinator's chunks weren't checked with the others
+    if (start_chain_length + args.size() != CHUNK_START_LENGTH) {
+      printf("expected %d integers as chunk prefix\n",
+             CHUNK_START_LENGTH - start_chain_length);
+      chunk_source.reject("wrong number of indices");
+      continue;
+    }
+    if (chunk_wrapped) {
+      print_chunk_begin(argv[0], args);
+      print_header();
+      chunk_timer.start();
+    }
+    reset_chunk_stats();
+    chunk_running = true;
+    heartbeat.begin_chunk(chunk_source.index - 1, chunk_source.size());
+    // the chains and the choices below the prefix are still the last chunk's
+    heartbeat_chains.store(0, std::memory_order_relaxed);
+    for (uint32_t i = CHUNK_START_LENGTH; i <= PRINT_PROGRESS_LENGTH; i++) {
+      heartbeat_choices[i].store(0, std::memory_order_relaxed);
+    }
+#if INSTRUMENT
+    instrument_chunk.clear();
+    for (const auto &arg : args) {
+      instrument_chunk += (instrument_chunk.empty() ? "" : " ") + arg;
+    }
+#endif
+
+    // the prefix of the last chunk is still restored, only the levels from
+    // the first index that differs are undone and restored again, for sorted
+    // chunks this walks the plan like a DFS
+    uint32_t same_size = start_chain_length;
+    for (uint32_t i = 0; i < args.size(); i++) {
+      const uint16_t index = atoi(args[i].c_str());
+      if (same_size == start_chain_length + i && same_size < chain_size &&
+          start_indices[same_size] == index) {
+        same_size++;
+      }
+      start_indices[start_chain_length + i] = index;
+    }
+
+    while (chain_size > same_size) {
+      chain_size--;
+      UNFULFILL_TARGETS(unseen[chain[chain_size]] >> 1)
+      for (uint32_t i = expressions_size[chain_size - 1];
+           i < expressions_size[chain_size]; i++) {
+        unseen[expressions[i]] |= 1;
+      }
+    }
+
+    // restore progress
+    while (chain_size < start_indices_size) {
+      GENERATE_NEW_EXPRESSIONS(chain_size, ADD_EXPRESSION)
+      // this can be used to output the first expressions with the index,
+      // which allows some custom order for promising expressions
+      // if (chain_size == 4) {
+      //   for (int m = 0; m < expressions_size[4]; m++) {
+      //     uint32_t e = expressions[m];
+      //     printf("%d: ", m);
+      //     for (uint32_t j = 0; j < 4; j++) {
+      //       for (uint32_t k = j + 1; k < 4; k++) {
+      //         char op = 0;
+      //         if (e == (chain[j] & chain[k])) {
+      //           op = '&';
+      //         } else if (e == (chain[j] | chain[k])) {
+      //           op = '|';
+      //         } else if (e == (chain[j] ^ chain[k])) {
+      //           op = '^';
+      //         } else if (e == ((~chain[j]) & chain[k])) {
+      //           op = '<';
+      //         } else if (e == (chain[j] & (~chain[k]))) {
+      //           op = '>';
+      //         } else {
+      //           continue;
+      //         }
+      //         printf(" = x%d %c x%d", j + 1, op, k + 1);
+      //       }
+      //     }
+      //     printf("\n");
+      //   }
+      // }
+      choices[chain_size] = start_indices[chain_size];
+      chain[chain_size] = expressions[choices[chain_size]];
+      not_chain[chain_size] = ~chain[chain_size];
+      CHOOSE_DERIVATION(chain_size, choices[chain_size])
+      FULFILL_TARGETS(unseen[chain[chain_size]] >> 1)
+      HEARTBEAT_CHOICE(chain_size, choices[chain_size],
+                       expressions_size[chain_size])
+      chain_size++;
+    }
+
+    uint32_t i8 = choices[chain_size - 1];
+#if MULTI_TARGET_SETS
+    const uint8_t live_8 = (1 << NUM_TARGET_SETS) - 1;
+#endif
 
 #endif
 
@@ -504,6 +1525,14 @@ int main(int argc, char *argv[]) {
   BACKTRACK_DFS(6, 5, 7)
   BACKTRACK_DFS(5, 4, 6)
   BACKTRACK_DFS(4, 3, 5)
+#else
+    heartbeat.end_chunk();
+    print_summary();
+    chunk_running = false;
+    if (chunk_wrapped) {
+      print_chunk_end(chunk_timer);
+    }
+  }
 #endif
 
   return 0;
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// --heartbeat <seconds> starts a thread that reports the progress of the
+// running chunk every few seconds: the chains per second, the choices of the
+// first levels of the chunk and the fraction done, estimated from the position
+// of these choices in their levels. The search doesn't do anything for it, the
+// thread samples the counters and choices the search keeps anyway, so a sample
+// can be a moment stale. The report goes to stderr, stdout stays in the format
+// progress parses, or with --status <file> it replaces that file, whose first
+// line is only the fraction done of all chunks, the format of the BOINC
+// wrapper's fraction_done_filename, e.g.
+//   full-search --heartbeat 60 --status fraction_done -f chunks.txt
+// With --worker or --shard the number of chunks isn't known in advance, then
+// the first line is the fraction done of the running chunk.
+
+struct HeartbeatSample {
+  uint64_t chains = 0;
+  // of the running chunk, clamped to [0, 1]
+  double fraction = 0;
+  std::string choices;
+};
+
+// the fraction of a level's range [first, limit) before choice, below is the
+// fraction of the choice's own subtree, a stale choice outside the range is
+// clamped
+inline double level_fraction(const uint32_t choice, const uint32_t first,
+                             const uint32_t limit, const double below) {
+  if (limit <= first || choice < first) {
+    return 0;
+  }
+  if (choice >= limit) {
+    return 1;
+  }
+  return (choice - first + below) / (limit - first);
+}
+
+struct Heartbeat {
+  uint32_t seconds = 0;
+  const char *status_path = nullptr;
+  // only called between begin_chunk and end_chunk
+  std::function<void(HeartbeatSample &)> sample;
+  std::mutex mutex;
+  bool running = false;
+  size_t chunk = 0;
+  // 0 if it isn't known
+  size_t num_chunks = 0;
+  double chunk_start = 0;
+  double last_time = 0;
+  uint64_t last_chains = 0;
+
+  // consumes --heartbeat <seconds> or --status <file>
+  bool parse_arg(const int argc, char *argv[], int &arg) {
+    if (arg + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[arg], "--heartbeat") == 0) {
+      seconds = atoi(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "--status") == 0) {
+      status_path = argv[arg + 1];
+    } else {
+      return false;
+    }
+    arg += 2;
+    return true;
+  }
+
+  static double now() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+  }
+
+  void start(const std::function<void(HeartbeatSample &)> &sampler) {
+    if (!seconds) {
+      return;
+    }
+    sample = sampler;
+    std::thread([this] {
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) {
+          beat();
+        }
+      }
+    }).detach();
+  }
+
+  void begin_chunk(const size_t index, const size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = true;
+    chunk = index;
+    num_chunks = count;
+    chunk_start = last_time = now();
+    last_chains = 0;
+  }
+
+  void end_chunk() {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+
+  void beat() {
+    HeartbeatSample current;
+    sample(current);
+    const double time = now();
+    // the chains per second since the last beat
+    const double rate =
+        current.chains >= last_chains && time > last_time
+            ? (current.chains - last_chains) / (time - last_time)
+            : 0;
+    last_chains = current.chains;
+    last_time = time;
+
+    const double fraction = current.fraction < 0   ? 0
+                            : current.fraction > 1 ? 1
+                                                   : current.fraction;
+    const double elapsed = time - chunk_start;
+    char eta[32] = "-";
+    if (fraction > 0) {
+      snprintf(eta, sizeof(eta), "%.0fs", elapsed * (1 - fraction) / fraction);
+    }
+    char chunk_label[48];
+    if (num_chunks) {
+      snprintf(chunk_label, sizeof(chunk_label), "%zu/%zu", chunk + 1,
+               num_chunks);
+    } else {
+      snprintf(chunk_label, sizeof(chunk_label), "%zu", chunk + 1);
+    }
+    char line[512];
+    snprintf(line, sizeof(line),
+             "heartbeat: chunk %s, choices: %s, chains: %" PRIu64
+             ", chains/s: %.0f, done: %.4f, elapsed: %.0fs, eta: %s\n",
+             chunk_label, current.choices.c_str(), current.chains, rate,
+             fraction, elapsed, eta);
+
+    if (status_path == nullptr) {
+      fputs(line, stderr);
+      return;
+    }
+    // written next to it and renamed, so a reader never sees half a file
+    const std::string tmp_path = std::string(status_path) + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    if (file == nullptr) {
+      return;
+    }
+    fprintf(file, "%.6f\n%s",
+            num_chunks ? (chunk + fraction) / num_chunks : fraction, line);
+    fclose(file);
+    rename(tmp_path.c_str(), status_path);
+  }
+};
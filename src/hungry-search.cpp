@@ -1,19 +1,46 @@
 #include "bit_set_fast.h"
+#include "chunks.h"
+#include "cpu_dispatch.h"
+#include "footprint_priorities.h"
+#include "heartbeat.h"
+#include "segment_targets.h"
+#include "worker.h"
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cinttypes>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <execinfo.h>
+#include <set>
 #include <signal.h>
 #include <tuple>
+#include <unistd.h>
 #include <vector>
 
 #ifndef CAPTURE_STATS
 #define CAPTURE_STATS 1
 #endif
 
+// -DEXHAUSTIVE_TAIL=K completes every node that is within K functions of the
+// limit with an exhaustive search like full-search's instead of the bites, so
+// no chain of the limit's length is missed below such a node
+#ifndef EXHAUSTIVE_TAIL
+#define EXHAUSTIVE_TAIL 0
+#endif
+
+#ifndef BEAM_CHILDREN
+#define BEAM_CHILDREN 8
+#endif
+
+// keep the derivation of every expression next to it, so the chains are
+// printed with the operation and operands that generated their functions
+// instead of searching all pairs for them
+#ifndef RECORD_DERIVATIONS
+#define RECORD_DERIVATIONS 0
+#endif
+
 #ifdef PROFILE_TIMERS
 #include <chrono>
 using prof_clock = std::chrono::steady_clock;
@@ -56,23 +83,19 @@ prof_clock::time_point prof_start_time;
 #endif
 
 constexpr uint32_t N = 16;
+// algorithm L and the cost tables cover all 1 << (N - 1) functions, wider
+// truth tables only work with full-search, see src/truth_table.h
+static_assert(N <= 16, "hungry-search needs N <= 16");
 constexpr uint32_t SIZE = 1 << (N - 1);
 constexpr uint32_t MAX_LENGTH = 22;
 constexpr uint32_t TAUTOLOGY = (1 << N) - 1;
-constexpr uint32_t TARGET_1 =
-    ((~(uint32_t)0b1011011111100011) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_2 =
-    ((~(uint32_t)0b1111100111100100) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_3 =
-    ((~(uint32_t)0b1101111111110100) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_4 =
-    ((~(uint32_t)0b1011011011011110) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_5 =
-    ((~(uint32_t)0b1010001010111111) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_6 =
-    ((~(uint32_t)0b1000111111110011) >> (16 - N)) & TAUTOLOGY;
-constexpr uint32_t TARGET_7 =
-    (((uint32_t)0b0011111011111111) >> (16 - N)) & TAUTOLOGY;
+constexpr uint32_t TARGET_1 = SEGMENT_TARGETS[0] >> (16 - N);
+constexpr uint32_t TARGET_2 = SEGMENT_TARGETS[1] >> (16 - N);
+constexpr uint32_t TARGET_3 = SEGMENT_TARGETS[2] >> (16 - N);
+constexpr uint32_t TARGET_4 = SEGMENT_TARGETS[3] >> (16 - N);
+constexpr uint32_t TARGET_5 = SEGMENT_TARGETS[4] >> (16 - N);
+constexpr uint32_t TARGET_6 = SEGMENT_TARGETS[5] >> (16 - N);
+constexpr uint32_t TARGET_7 = SEGMENT_TARGETS[6] >> (16 - N);
 constexpr uint32_t TARGETS[] = {
     TARGET_1, TARGET_2, TARGET_3, TARGET_4, TARGET_5, TARGET_6, TARGET_7,
 };
@@ -89,19 +112,130 @@ uint64_t stats_num_data_points[25] = {0};
 uint64_t stats_num_tries[25] = {0};
 #endif
 
+// -b for branch and bound, a chain of length L limits the rest of the chunk
+// to chains of length L - 1, -B to length L to also get the other chains of
+// the best length, every chunk starts without a limit, so its output doesn't
+// depend on the chunks before it, --limit <length> starts them at the limit
+// a search that was cut off had reached
+bool bound_mode = false;
+bool bound_equal = false;
+size_t start_limit = MAX_LENGTH;
+
+// -w <width> for a beam search instead of the DFS, each level keeps the best
+// <width> chains and tries the BEAM_CHILDREN best expressions of each of them,
+// few children per chain keep the beam from filling up with siblings
+size_t beam_width = 0;
+
+// --deadline <seconds> stops the search when the time is up, or on SIGINT or
+// SIGTERM, and prints the best chain and the position and limit to resume
+// from, the search then runs in passes that widen the bites up to bite_size,
+// starting at --width <width>, so the narrow passes give a chain early, it
+// implies -b
+uint32_t deadline = 0;
+size_t start_width = 1;
+volatile sig_atomic_t deadline_reached = 0;
+uint32_t best_chain[MAX_LENGTH];
+uint32_t best_derivations[MAX_LENGTH];
+size_t best_chain_size = 0;
+
+// set while a chunk runs, so an interrupted chunk still prints its summary
+bool chunk_running = false;
+bool chunk_wrapped = false;
+ChunkTimer chunk_timer;
+
+// --heartbeat <seconds> and --status <file>, see src/heartbeat.h, the thread
+// reads the chains, the choices and the ends of the levels from here instead
+// of main's, the search publishes them with relaxed stores, heartbeat_level
+// is the first level the chunk searches, the fraction is the position in it
+// and the level after it
+Heartbeat heartbeat;
+std::atomic<uint64_t> heartbeat_chains;
+std::atomic<uint32_t> heartbeat_choices[MAX_LENGTH];
+std::atomic<uint32_t> heartbeat_limits[MAX_LENGTH];
+std::atomic<size_t> heartbeat_level;
+std::atomic<uint32_t> heartbeat_first;
+
+void publish_chains() {
+  heartbeat_chains.store(total_chains, std::memory_order_relaxed);
+}
+
+void publish_choice(const size_t level, const uint32_t choice,
+                    const uint32_t limit) {
+  heartbeat_choices[level].store(choice, std::memory_order_relaxed);
+  heartbeat_limits[level].store(limit, std::memory_order_relaxed);
+}
+
+void sample_heartbeat(HeartbeatSample &sample) {
+  sample.chains = heartbeat_chains.load(std::memory_order_relaxed);
+  const size_t level = heartbeat_level.load(std::memory_order_relaxed);
+  uint32_t choices[MAX_LENGTH];
+  uint32_t limits[MAX_LENGTH];
+  for (size_t i = 0; i < MAX_LENGTH; i++) {
+    choices[i] = heartbeat_choices[i].load(std::memory_order_relaxed);
+    limits[i] = heartbeat_limits[i].load(std::memory_order_relaxed);
+  }
+  double fraction = 0;
+  if (level + 1 < MAX_LENGTH) {
+    fraction = level_fraction(choices[level + 1], 0, limits[level + 1], 0);
+  }
+  sample.fraction =
+      level_fraction(choices[level],
+                     heartbeat_first.load(std::memory_order_relaxed),
+                     limits[level], fraction);
+  for (size_t i = start_chain_length; i <= level + 1 && i < MAX_LENGTH; i++) {
+    char choice[16];
+    snprintf(choice, sizeof(choice), i == start_chain_length ? "%u" : " %u",
+             choices[i]);
+    sample.choices += choice;
+  }
+}
+
 BitSet footprints[SIZE];
 uint8_t costs[SIZE] __attribute__((aligned(64))) = {0};
 uint32_t levels[50][50000] __attribute__((aligned(64))) = {0};
 size_t levels_size[10] = {0};
-uint8_t frequencies[50000];
+// index of each function in its level, only set for the levels from 2 on, the
+// chain and the first expressions never get a lower cost
+uint32_t level_positions[SIZE];
+// the sort key of every first expression, see get_priority
+uint32_t priority_keys[50000];
 uint8_t target_lookup[SIZE] __attribute__((aligned(64))) = {0};
+#if EXHAUSTIVE_TAIL
+// bit 0: not in the tail's expressions yet, bit 1: unfulfilled target, like
+// unseen in full-search
+uint8_t tail_unseen[SIZE] __attribute__((aligned(64)));
+uint32_t tail_expressions[SIZE] __attribute__((aligned(64)));
+#endif
+#if RECORD_DERIVATIONS
+// op | j << 8 | k << 16 for f = chain[j] op chain[k], op is one of & | ^ < >
+// like in print_expression, 0 for the inputs, the first expressions' are in
+// the order of levels[1], the DFS keeps a copy per level like its expressions
+uint32_t first_derivations[50000];
+uint32_t expression_derivations[MAX_LENGTH][50000];
+#if EXHAUSTIVE_TAIL
+uint32_t tail_derivations[SIZE];
+#endif
+#endif
 
-#define ADD_FIRST_EXPRESSION(value)                                            \
+#define DERIVATION(op, j, k)                                                   \
+  ((uint32_t)(op) | ((uint32_t)(j) << 8) | ((uint32_t)(k) << 16))
+#if RECORD_DERIVATIONS
+#define RECORD_DERIVATION(derivations, index, derivation)                      \
+  derivations[index] = derivation;
+#define COPY_DERIVATIONS(to, from, size)                                       \
+  memcpy(to, from, sizeof(uint32_t) * (size));
+#else
+#define RECORD_DERIVATION(derivations, index, derivation)
+#define COPY_DERIVATIONS(to, from, size)
+#endif
+
+#define ADD_FIRST_EXPRESSION(value, derivation)                                \
   {                                                                            \
     uint32_t f = value;                                                        \
     if (costs[f] == 0xff) {                                                    \
       costs[f] = 1;                                                            \
       levels[1][levels_size[1]] = f;                                           \
+      RECORD_DERIVATION(first_derivations, levels_size[1], derivation)         \
       footprints[f].insert(levels_size[1]);                                    \
       levels_size[1]++;                                                        \
       c--;                                                                     \
@@ -109,11 +243,13 @@ uint8_t target_lookup[SIZE] __attribute__((aligned(64))) = {0};
   }
 
 #define GENERATE_NEW_EXPRESSIONS                                               \
-  algorithm_l_with_footprints(chain, chain_size);                              \
+  algorithm_l_with_footprints(chain, chain_size, limit - chain_size);          \
                                                                                \
   expressions_size[chain_size] = levels_size[1];                               \
   memcpy(expressions[chain_size], levels[1],                                   \
          sizeof(uint32_t) * expressions_size[chain_size]);                     \
+  COPY_DERIVATIONS(expression_derivations[chain_size], first_derivations,      \
+                   expressions_size[chain_size])                               \
                                                                                \
   priorities[chain_size].clear();                                              \
   for (size_t i = 0; i < expressions_size[chain_size]; i++) {                  \
@@ -126,12 +262,20 @@ uint8_t target_lookup[SIZE] __attribute__((aligned(64))) = {0};
                                                                                \
   PROF_TBEGIN(sort);                                                           \
   sort(priorities[chain_size].begin(), priorities[chain_size].end(),           \
-       [&](size_t x, size_t y) { return get_priority(x) < get_priority(y); });\
+       [&](size_t x, size_t y) { return get_priority(x) < get_priority(y); }); \
   PROF_TEND(sort);
 
-void print_expression(const uint32_t *chain, const uint32_t index,
-                      const size_t chain_size, const uint32_t f) {
+void print_expression([[maybe_unused]] const uint32_t *chain,
+                      const uint32_t index, const size_t, const uint32_t f,
+                      [[maybe_unused]] const uint32_t derivation) {
   printf("x%d", index + 1);
+#if RECORD_DERIVATIONS
+  // only the derivation that generated the function
+  if (derivation & 0xff) {
+    printf(" = x%d %c x%d", ((derivation >> 8) & 0xff) + 1, derivation & 0xff,
+           (derivation >> 16) + 1);
+  }
+#else
   for (size_t j = 0; j < index; j++) {
     for (size_t k = j + 1; k < index; k++) {
       char op = 0;
@@ -152,33 +296,47 @@ void print_expression(const uint32_t *chain, const uint32_t index,
       printf(" = x%zu %c x%zu", j + 1, op, k + 1);
     }
   }
+#endif
   printf(" = %s", std::bitset<N>(f).to_string().c_str());
   if (target_lookup[f]) {
     printf(" [target]");
   }
 }
 
-void print_chain(const uint32_t *chain, const size_t chain_size) {
+void print_chain(const uint32_t *chain, const uint32_t *derivations,
+                 const size_t chain_size) {
   printf("hungry chain (%zu):\n", chain_size);
   for (size_t i = 0; i < chain_size; i++) {
-    print_expression(chain, i, chain_size, chain[i]);
+    print_expression(chain, i, chain_size, chain[i], derivations[i]);
     printf("\n");
   }
   printf("\n");
 }
 
-void erase(uint32_t *array, size_t &array_size, uint32_t f) {
-  for (size_t i = 0; i < array_size; i++) {
-    if (array[i] == f) {
-      if (i < array_size - 1) {
-        array[i] = array[array_size - 1];
-      }
-      array_size--;
-      return;
-    }
+void found_chain(const uint32_t *chain, const uint32_t *derivations,
+                 const size_t chain_size, size_t &limit,
+                 size_t &current_best_length) {
+  print_chain(chain, derivations, chain_size);
+  if (chain_size < current_best_length) {
+    current_best_length = chain_size;
+    memcpy(best_chain, chain, sizeof(uint32_t) * chain_size);
+    COPY_DERIVATIONS(best_derivations, derivations, chain_size)
+    best_chain_size = chain_size;
+  }
+  if (bound_mode) {
+    limit = chain_size - 1 + bound_equal;
   }
 }
 
+// moves the last function of the level into the gap
+void erase(uint32_t *array, size_t &array_size, uint32_t f) {
+  const uint32_t i = level_positions[f];
+  const uint32_t last = array[array_size - 1];
+  array[i] = last;
+  level_positions[last] = i;
+  array_size--;
+}
+
 void generate_first_expressions(const uint32_t *chain, const size_t chain_size,
                                 uint32_t &c) {
   // U1. Initialize
@@ -199,17 +357,25 @@ void generate_first_expressions(const uint32_t *chain, const size_t chain_size,
       uint32_t h = chain[k];
       uint32_t not_h = ~h;
 
-      ADD_FIRST_EXPRESSION(g & h);
-      ADD_FIRST_EXPRESSION(not_g & h);
-      ADD_FIRST_EXPRESSION(g & not_h);
-      ADD_FIRST_EXPRESSION(g | h);
-      ADD_FIRST_EXPRESSION(g ^ h);
+      ADD_FIRST_EXPRESSION(g & h, DERIVATION('&', j, k));
+      ADD_FIRST_EXPRESSION(not_g & h, DERIVATION('<', j, k));
+      ADD_FIRST_EXPRESSION(g & not_h, DERIVATION('>', j, k));
+      ADD_FIRST_EXPRESSION(g | h, DERIVATION('|', j, k));
+      ADD_FIRST_EXPRESSION(g ^ h, DERIVATION('^', j, k));
     }
   }
 }
 
+// Algorithm L's costs are only upper bounds, but a target it prices above the
+// budget isn't worth steering the search to from this node, so the levels
+// past the budget aren't generated, such targets keep the cost 0xff and an
+// empty footprint and don't count for the priorities. Pass r also finds
+// functions of cost r - 1, so the passes run to budget + 1 and only the
+// targets that pass prices above the budget are dropped again
+CPU_DISPATCH_CLONES
 void algorithm_l_with_footprints(const uint32_t *chain,
-                                 const size_t chain_size) {
+                                 const size_t chain_size,
+                                 const uint32_t budget) {
 #ifdef PROFILE_TIMERS
   prof_calls++;
 #endif
@@ -230,7 +396,7 @@ void algorithm_l_with_footprints(const uint32_t *chain,
   PROF_TBEGIN(u4);
   // U3. Loop over r = 2, 3, ... while c > 0
   uint32_t r;
-  for (r = 2; c > 0; ++r) {
+  for (r = 2; c > 0 && r <= budget + 1; ++r) {
     levels_size[r] = 0;
 
     bool all_targets_found = true;
@@ -277,6 +443,7 @@ void algorithm_l_with_footprints(const uint32_t *chain,
                {g & h, not_g & h, g & not_h, g | h, g ^ h}) {
             if (costs[f] == 0xff) {
               costs[f] = u;
+              level_positions[f] = levels_size[u];
               levels[u][levels_size[u]] = f;
               levels_size[u]++;
               footprints[f] = v;
@@ -285,6 +452,7 @@ void algorithm_l_with_footprints(const uint32_t *chain,
               const uint32_t previous_u = costs[f];
               erase(levels[previous_u], levels_size[previous_u], f);
               costs[f] = u;
+              level_positions[f] = levels_size[u];
               levels[u][levels_size[u]] = f;
               levels_size[u]++;
               footprints[f] = v;
@@ -299,35 +467,318 @@ void algorithm_l_with_footprints(const uint32_t *chain,
 
   PROF_TEND(u4);
 
+  for (size_t i = 0; i < NUM_TARGETS; i++) {
+    if (costs[TARGETS[i]] != 0xff && costs[TARGETS[i]] > budget) {
+      costs[TARGETS[i]] = 0xff;
+      footprints[TARGETS[i]] = BitSet();
+    }
+  }
+
   PROF_TBEGIN(capture_stats);
   CAPTURE_STATS_CALL
   PROF_TEND(capture_stats);
 }
 
+// see src/footprint_priorities.h
 void count_first_expressions_in_footprints(const uint32_t expressions_size) {
-  memset(frequencies, 0, sizeof(uint8_t) * expressions_size);
+  footprint_priority_keys<NUM_TARGETS>(footprints, costs, TARGETS,
+                                       priority_keys, expressions_size);
+}
 
-  for (const uint32_t &f : TARGETS) {
-    for (size_t i = 0; i < expressions_size; i++) {
-      if (footprints[f].get(i)) {
-        frequencies[i]++;
+// orders like the tuple (lowest target cost, -frequency, -index)
+uint32_t get_priority(const size_t index) { return priority_keys[index]; }
+
+#if EXHAUSTIVE_TAIL
+#define ADD_TAIL_EXPRESSION(value, derivation)                                 \
+  {                                                                            \
+    const uint32_t _f = value;                                                 \
+    if (tail_unseen[_f] & 1) {                                                 \
+      RECORD_DERIVATION(tail_derivations, expressions_size, derivation)        \
+      tail_expressions[expressions_size++] = _f;                               \
+      tail_unseen[_f] &= 2;                                                    \
+    }                                                                          \
+  }
+
+#define ADD_TAIL_EXPRESSIONS(h, k, from, to)                                   \
+  for (size_t _j = from; _j < to; _j++) {                                      \
+    const uint32_t g = chain[_j];                                              \
+    ADD_TAIL_EXPRESSION(g & h, DERIVATION('&', _j, k));                        \
+    ADD_TAIL_EXPRESSION(~g & h, DERIVATION('<', _j, k));                       \
+    ADD_TAIL_EXPRESSION(g & ~h, DERIVATION('>', _j, k));                       \
+    ADD_TAIL_EXPRESSION(g | h, DERIVATION('|', _j, k));                        \
+    ADD_TAIL_EXPRESSION(g ^ h, DERIVATION('^', _j, k));                        \
+  }
+
+// every set of functions is tried once, in the order of the expressions, and
+// a target ends the level, as it can't be added behind a later expression
+void exhaustive_tail(uint32_t *chain, uint32_t *derivations,
+                     const size_t chain_size,
+                     const uint32_t first, const uint32_t old_size,
+                     const uint32_t num_unfulfilled, size_t &limit,
+                     size_t &current_best_length) {
+  for (uint32_t i = first; i < old_size; i++) {
+    // the limit drops in bound mode
+    if (chain_size + num_unfulfilled > limit || deadline_reached) {
+      return;
+    }
+
+    const uint32_t f = tail_expressions[i];
+    const uint32_t is_target = tail_unseen[f] >> 1;
+    if (chain_size + num_unfulfilled == limit && !is_target) {
+      continue;
+    }
+
+    chain[chain_size] = f;
+    RECORD_DERIVATION(derivations, chain_size, tail_derivations[i])
+    total_chains++;
+    publish_chains();
+
+    if (num_unfulfilled == is_target) {
+      found_chain(chain, derivations, chain_size + 1, limit,
+                  current_best_length);
+      return;
+    }
+
+    if (chain_size + 1 + num_unfulfilled - is_target <= limit) {
+      uint32_t expressions_size = old_size;
+      ADD_TAIL_EXPRESSIONS(f, chain_size, 0, chain_size)
+      exhaustive_tail(chain, derivations, chain_size + 1, i + 1, expressions_size,
+                      num_unfulfilled - is_target, limit, current_best_length);
+      for (uint32_t j = old_size; j < expressions_size; j++) {
+        tail_unseen[tail_expressions[j]] |= 1;
       }
     }
+
+    if (is_target) {
+      return;
+    }
   }
 }
 
-auto get_priority(const size_t index) {
-  int min_value = 1000;
-  for (const auto &y : TARGETS) {
-    if (footprints[y].get(index)) {
-      min_value = min(min_value, static_cast<int>(costs[y]));
-    }
+void start_exhaustive_tail(uint32_t *chain, uint32_t *derivations,
+                           const size_t chain_size,
+                           const uint32_t num_unfulfilled, size_t &limit,
+                           size_t &current_best_length) {
+  memset(tail_unseen, 1, sizeof(tail_unseen));
+  for (const uint32_t &f : TARGETS) {
+    tail_unseen[f] = 3;
+  }
+  tail_unseen[0] = 0;
+  for (size_t i = 0; i < chain_size; i++) {
+    tail_unseen[chain[i]] = 0;
+  }
+
+  uint32_t expressions_size = 0;
+  for (size_t k = 1; k < chain_size; k++) {
+    const uint32_t h = chain[k];
+    ADD_TAIL_EXPRESSIONS(h, k, 0, k)
   }
-  return make_tuple(min_value, -static_cast<int>(frequencies[index]),
-                    -static_cast<int>(index));
+
+  exhaustive_tail(chain, derivations, chain_size, 0, expressions_size, num_unfulfilled,
+                  limit, current_best_length);
+}
+#endif
+
+struct BeamNode {
+  uint32_t chain[MAX_LENGTH];
+  uint32_t derivations[MAX_LENGTH];
+  size_t chain_size;
+  uint32_t num_unfulfilled;
+  // sum of the costs of the unfulfilled targets, then the number of first
+  // expressions in their footprints, fewer means more of them are shared
+  pair<uint32_t, uint32_t> score;
+  vector<uint32_t> candidates;
+#if RECORD_DERIVATIONS
+  vector<uint32_t> candidate_derivations;
+#endif
 };
 
-void on_exit() {
+// runs algorithm L for the node, returns false if a target is out of reach
+bool evaluate_beam_node(BeamNode &node, const size_t limit) {
+  algorithm_l_with_footprints(node.chain, node.chain_size,
+                              limit - node.chain_size);
+
+  uint32_t sum = 0;
+  BitSet used;
+  for (const uint32_t &f : TARGETS) {
+    if (costs[f] == 0) {
+      continue;
+    }
+    if (costs[f] == 0xff) {
+      return false;
+    }
+    sum += costs[f];
+    used.add(footprints[f]);
+  }
+  uint32_t shared = 0;
+  for (size_t w = 0; w < ARRAY_SIZE; w++) {
+    shared += __builtin_popcountll(used.word(w));
+  }
+  node.score = make_pair(sum, shared);
+
+  // a target that can be added now is always worth adding
+  node.candidates.clear();
+#if RECORD_DERIVATIONS
+  node.candidate_derivations.clear();
+#endif
+  for (size_t i = 0; i < levels_size[1]; i++) {
+    if (target_lookup[levels[1][i]]) {
+      node.candidates.push_back(levels[1][i]);
+#if RECORD_DERIVATIONS
+      node.candidate_derivations.push_back(first_derivations[i]);
+#endif
+      return true;
+    }
+  }
+
+  const uint32_t expressions_size = levels_size[1];
+  count_first_expressions_in_footprints(expressions_size);
+  vector<uint32_t> order(expressions_size);
+  for (uint32_t i = 0; i < expressions_size; i++) {
+    order[i] = i;
+  }
+  const size_t num_candidates = min((size_t)BEAM_CHILDREN, order.size());
+  partial_sort(order.begin(), order.begin() + num_candidates, order.end(),
+               [](uint32_t x, uint32_t y) {
+                 return get_priority(x) < get_priority(y);
+               });
+  for (size_t i = 0; i < num_candidates; i++) {
+    node.candidates.push_back(levels[1][order[i]]);
+#if RECORD_DERIVATIONS
+    node.candidate_derivations.push_back(first_derivations[order[i]]);
+#endif
+  }
+  return true;
+}
+
+// expands level by level and stops at the first level that completes a chain,
+// the levels after it can only hold longer chains
+void beam_search(const uint32_t *chain,
+                 [[maybe_unused]] const uint32_t *derivations,
+                 const size_t chain_size, const uint32_t num_unfulfilled,
+                 size_t &limit, size_t &current_best_length) {
+  vector<BeamNode> beam(1);
+  memcpy(beam[0].chain, chain, sizeof(uint32_t) * chain_size);
+  COPY_DERIVATIONS(beam[0].derivations, derivations, chain_size)
+  beam[0].chain_size = chain_size;
+  beam[0].num_unfulfilled = num_unfulfilled;
+  if (!evaluate_beam_node(beam[0], limit)) {
+    return;
+  }
+
+  while (!beam.empty() && !deadline_reached) {
+    vector<BeamNode> next;
+    // the same set of functions is reached in different orders
+    set<vector<uint32_t>> seen;
+    bool found = false;
+
+    for (const auto &node : beam) {
+      for (size_t c = 0; c < node.candidates.size(); c++) {
+        const uint32_t f = node.candidates[c];
+        BeamNode child;
+        memcpy(child.chain, node.chain, sizeof(uint32_t) * node.chain_size);
+        child.chain[node.chain_size] = f;
+        COPY_DERIVATIONS(child.derivations, node.derivations, node.chain_size)
+        RECORD_DERIVATION(child.derivations, node.chain_size,
+                          node.candidate_derivations[c])
+        child.chain_size = node.chain_size + 1;
+        child.num_unfulfilled = node.num_unfulfilled - target_lookup[f];
+        total_chains++;
+        publish_chains();
+
+        if (child.num_unfulfilled == 0) {
+          found_chain(child.chain, child.derivations, child.chain_size, limit,
+                      current_best_length);
+          found = true;
+          continue;
+        }
+
+        if (child.chain_size + child.num_unfulfilled > limit) {
+          continue;
+        }
+
+        vector<uint32_t> key(child.chain + chain_size,
+                             child.chain + child.chain_size);
+        sort(key.begin(), key.end());
+        if (!seen.insert(key).second) {
+          continue;
+        }
+
+#if EXHAUSTIVE_TAIL
+        if (child.chain_size + EXHAUSTIVE_TAIL >= limit) {
+          const size_t best_length = current_best_length;
+          start_exhaustive_tail(child.chain, child.derivations,
+                                child.chain_size, child.num_unfulfilled, limit,
+                                current_best_length);
+          found |= current_best_length < best_length;
+          continue;
+        }
+#endif
+
+        if (evaluate_beam_node(child, limit)) {
+          next.push_back(std::move(child));
+        }
+      }
+    }
+
+    if (found) {
+      return;
+    }
+
+    stable_sort(next.begin(), next.end(),
+                [](const BeamNode &x, const BeamNode &y) {
+                  return x.score < y.score;
+                });
+    if (next.size() > beam_width) {
+      next.resize(beam_width);
+    }
+    if (!next.empty()) {
+      printf("beam level %zu: %zu chains, best score %u %u [best: %zu] "
+             "%" PRIu64 "\n",
+             next[0].chain_size, next.size(), next[0].score.first,
+             next[0].score.second, current_best_length, total_chains);
+      fflush(stdout);
+    }
+    beam = std::move(next);
+  }
+}
+
+void print_header() {
+  printf("hungry-search: N = %d, MAX_LENGTH: %d, CAPTURE_STATS: %d", N,
+         MAX_LENGTH, CAPTURE_STATS);
+  if (EXHAUSTIVE_TAIL) {
+    printf(", EXHAUSTIVE_TAIL: %d", EXHAUSTIVE_TAIL);
+  }
+  if (bound_mode) {
+    printf(", BOUND: %s", bound_equal ? "equal" : "shorter");
+  }
+  if (CPU_DISPATCH) {
+    printf(", CPU: %s", cpu_variant());
+  }
+  if (beam_width) {
+    printf(", BEAM: %zu", beam_width);
+  }
+  if (deadline) {
+    printf(", DEADLINE: %us", deadline);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+void reset_chunk_stats() {
+  total_chains = 0;
+
+#if CAPTURE_STATS
+  memset(stats_total_num_expressions, 0, sizeof(stats_total_num_expressions));
+  memset(stats_min_num_expressions, UNDEFINED,
+         sizeof(stats_min_num_expressions));
+  memset(stats_max_num_expressions, 0, sizeof(stats_max_num_expressions));
+  memset(stats_num_data_points, 0, sizeof(stats_num_data_points));
+  memset(stats_num_tries, 0, sizeof(stats_num_tries));
+#endif
+}
+
+void print_summary() {
   printf("total chains: %" PRIu64 "\n", total_chains);
 
 #if CAPTURE_STATS
@@ -352,6 +803,15 @@ void on_exit() {
                : stats_num_tries[i] / stats_num_data_points[i]);
   }
 #endif
+}
+
+void on_exit() {
+  if (chunk_running) {
+    print_summary();
+    if (chunk_wrapped) {
+      print_chunk_end(chunk_timer);
+    }
+  }
 
 #ifdef PROFILE_TIMERS
   uint64_t prof_total_ns = (uint64_t)std::chrono::duration_cast<
@@ -405,11 +865,86 @@ void on_exit() {
 
 void signal_handler(int signal) { exit(signal); }
 
+void deadline_handler(int) { deadline_reached = 1; }
+
+// the chunks of --shard, see src/chunks.h, every combination of the choices
+// within the bites of the levels before the depth, in the order of the DFS,
+// the search ends a chunk whose choice is beyond its level's expressions
+#define DEFAULT_SHARD_DEPTH 7
+
+struct ShardEnumerator {
+  Shard shard;
+  vector<size_t> limits;
+  vector<size_t> choices;
+  // of the prefixes up to the depth
+  uint64_t position = 0;
+
+  bool next(ChunkArgs &args) {
+    do {
+      if (position == 0 && choices.empty()) {
+        choices.assign(limits.size(), 0);
+      } else {
+        size_t i = choices.size();
+        while (i > 0 && ++choices[i - 1] == limits[i - 1]) {
+          choices[--i] = 0;
+        }
+        if (i == 0) {
+          return false;
+        }
+      }
+    } while (!shard.owns(position++));
+
+    args.assign(1, "-c");
+    for (const size_t choice : choices) {
+      args.push_back(to_string(choice));
+    }
+    return true;
+  }
+};
+ShardEnumerator shard_enumerator;
+
+// the position is the progress vector of the node the search would expand
+// next, "+" separates it from the chunk, which still ends the search, the
+// limit keeps the resumed search from reporting chains that aren't better
+void print_deadline(const uint32_t *choices, const size_t chain_size,
+                    const bool chunk_mode, const size_t stop_chain_size,
+                    const size_t width, const size_t limit) {
+  printf("deadline reached, best: %zu\n", best_chain_size);
+  for (size_t i = 0; i < best_chain_size; i++) {
+    print_expression(best_chain, i, best_chain_size, best_chain[i],
+                     best_derivations[i]);
+    printf("\n");
+  }
+  if (beam_width) {
+    printf("\n");
+    return;
+  }
+
+  printf("resume: --deadline %u --width %zu", deadline, width);
+  if (limit < MAX_LENGTH) {
+    printf(" --limit %zu", limit);
+  }
+  size_t i = start_chain_length;
+  if (chunk_mode) {
+    printf(" -c");
+    for (; i < stop_chain_size; i++) {
+      printf(" %d", choices[i]);
+    }
+    printf(" +");
+  }
+  for (; i < chain_size; i++) {
+    printf(" %d", choices[i]);
+  }
+  printf("\n\n");
+  fflush(stdout);
+}
+
 int main(int argc, char *argv[]) {
   bool chunk_mode = false;
   size_t stop_chain_size;
   uint32_t dummy_c = 0;
   uint32_t chain[MAX_LENGTH] __attribute__((aligned(64)));
+  uint32_t chain_derivations[MAX_LENGTH] = {0};
   uint32_t num_unfulfilled_targets = NUM_TARGETS;
   uint32_t expressions[MAX_LENGTH][50000] __attribute__((aligned(64)));
   uint32_t expressions_size[MAX_LENGTH] __attribute__((aligned(64)));
@@ -418,6 +953,7 @@ int main(int argc, char *argv[]) {
   size_t start_indices_size __attribute__((aligned(64))) = 0;
   uint16_t start_indices[100] __attribute__((aligned(64))) = {0};
   size_t current_best_length = 1000;
+  size_t limit = MAX_LENGTH;
   size_t bite_size[25] = {0};
   for (size_t i = 0; i < MAX_LENGTH; i++) {
     bite_size[i] = 1;
@@ -466,126 +1002,348 @@ int main(int argc, char *argv[]) {
   size_t chain_size = 4;
   start_chain_length = chain_size;
 
-  size_t start_i = 1;
-  // -c for chunk mode, only complete one slice of the depth given by the
-  // progress vector
-  if (argc > 1 && strcmp(argv[1], "-c") == 0) {
-    start_i++;
-    chunk_mode = true;
+  // one or more progress vectors, each optionally preceded by -c
+  ChunkSource chunk_source;
+  int first_arg = 1;
+  while (first_arg < argc) {
+    if (strcmp(argv[first_arg], "-b") == 0 ||
+        strcmp(argv[first_arg], "-B") == 0) {
+      bound_mode = true;
+      bound_equal = argv[first_arg][1] == 'B';
+      first_arg++;
+    } else if (strcmp(argv[first_arg], "-w") == 0 && first_arg + 1 < argc) {
+      beam_width = atoi(argv[first_arg + 1]);
+      first_arg += 2;
+    } else if (strcmp(argv[first_arg], "--deadline") == 0 &&
+               first_arg + 1 < argc) {
+      deadline = atoi(argv[first_arg + 1]);
+      first_arg += 2;
+    } else if (strcmp(argv[first_arg], "--width") == 0 &&
+               first_arg + 1 < argc) {
+      start_width = atoi(argv[first_arg + 1]);
+      first_arg += 2;
+    } else if (strcmp(argv[first_arg], "--limit") == 0 &&
+               first_arg + 1 < argc) {
+      start_limit = min<size_t>(atoi(argv[first_arg + 1]), MAX_LENGTH);
+      first_arg += 2;
+    } else if (!heartbeat.parse_arg(argc, argv, first_arg) &&
+               !chunk_source.worker.parse_arg(argc, argv, first_arg) &&
+               !chunk_source.shard.parse_arg(argc, argv, first_arg)) {
+      break;
+    }
   }
+  heartbeat.start(sample_heartbeat);
 
-  for (size_t i = 0; i < chain_size; i++) {
-    start_indices[start_indices_size++] = 0;
+  if (!chunk_source.read(argc, argv, first_arg)) {
+    return -1;
+  }
+  if (chunk_source.shard.enabled()) {
+    const size_t depth = chunk_source.shard.depth ? chunk_source.shard.depth
+                                                  : DEFAULT_SHARD_DEPTH;
+    if (depth <= chain_size || depth >= MAX_LENGTH) {
+      printf("the shard depth must be in %zu..%u\n", chain_size + 1,
+             MAX_LENGTH - 1);
+      return -1;
+    }
+    shard_enumerator.shard = chunk_source.shard;
+    shard_enumerator.limits.assign(bite_size + chain_size, bite_size + depth);
+    chunk_source.enumerate = [](ChunkArgs &args) {
+      return shard_enumerator.next(args);
+    };
   }
+  chunk_wrapped = chunk_source.list.wrapped;
 
-  // read the progress vector, e.g 5 2 9, commas will be ignored: 5, 2, 9
-  for (size_t i = start_i; i < argc; i++) {
-    start_indices[start_indices_size++] = atoi(argv[i]);
+  size_t max_bite_size = 0;
+  size_t full_bite_size[25];
+  memcpy(full_bite_size, bite_size, sizeof(bite_size));
+  for (size_t i = 0; i < MAX_LENGTH; i++) {
+    max_bite_size = max(max_bite_size, bite_size[i]);
   }
 
-  stop_chain_size = start_chain_length;
-  if (chunk_mode) {
-    stop_chain_size = start_indices_size;
+  if (deadline) {
+    if (!bound_mode) {
+      bound_mode = true;
+      bound_equal = false;
+    }
+    signal(SIGINT, deadline_handler);
+    signal(SIGTERM, deadline_handler);
+    signal(SIGALRM, deadline_handler);
+    alarm(deadline);
   }
 
-  printf("hungry-search: N = %d, MAX_LENGTH: %d, CAPTURE_STATS: %d\n", N,
-         MAX_LENGTH, CAPTURE_STATS);
-  fflush(stdout);
+  if (!chunk_wrapped) {
+    print_header();
+  }
 
-  // restore progress
-  if (start_indices_size > start_chain_length) {
-    while (chain_size < start_indices_size) {
-      GENERATE_NEW_EXPRESSIONS
-      choices[chain_size] = start_indices[chain_size];
-      chain[chain_size] =
-          expressions[chain_size][priorities[chain_size][choices[chain_size]]];
-      num_unfulfilled_targets -= target_lookup[chain[chain_size]];
-      chain_size++;
+  for (size_t i = 0; i < chain_size; i++) {
+    start_indices[start_indices_size++] = 0;
+  }
+
+  // the levels of the last chunk's prefix keep their expressions, so a chunk
+  // only generates the levels from the first index that differs, the algorithm
+  // L stats only count the levels that were generated
+  size_t restored_size = start_chain_length;
+
+  for (ChunkArgs args; chunk_source.next(args);) {
+    if (deadline_reached) {
+      // a worker gives the chunk back for another worker to run
+      if (chunk_source.worker.enabled()) {
+        chunk_source.worker.release_chunk();
+        break;
+      }
+      printf("not started:");
+      for (const auto &arg : args) {
+        printf(" %s", arg.c_str());
+      }
+      printf("\n");
+      continue;
+    }
+
+    if (chunk_wrapped) {
+      print_chunk_begin(argv[0], args);
+      print_header();
+      chunk_timer.start();
+    }
+    reset_chunk_stats();
+    chunk_running = true;
+    heartbeat.begin_chunk(chunk_source.index - 1, chunk_source.size());
+    // a resumed search's best length is the one its limit came from
+    limit = start_limit;
+    current_best_length = limit < MAX_LENGTH ? limit + 1 - bound_equal : 1000;
+    best_chain_size = 0;
+    size_t width = start_width;
+    bool chunk_cut = false;
+
+    size_t start_i = 0;
+    // -c for chunk mode, only complete one slice of the depth given by the
+    // progress vector
+    chunk_mode = false;
+    if (!args.empty() && args[0] == "-c") {
+      start_i++;
+      chunk_mode = true;
+    }
+
+    // read the progress vector, e.g 5 2 9, commas will be ignored: 5, 2, 9
+    size_t reused_size = start_chain_length;
+    start_indices_size = start_chain_length;
+    size_t chunk_indices_size = 0;
+    for (size_t i = start_i; i < args.size(); i++) {
+      if (args[i] == "+") {
+        chunk_indices_size = start_indices_size;
+        continue;
+      }
+      const uint16_t index = atoi(args[i].c_str());
+      if (reused_size == start_indices_size &&
+          start_indices_size < restored_size &&
+          start_indices[start_indices_size] == index) {
+        reused_size++;
+      }
+      start_indices[start_indices_size++] = index;
+    }
+
+    stop_chain_size = start_chain_length;
+    if (chunk_mode) {
+      stop_chain_size =
+          chunk_indices_size ? chunk_indices_size : start_indices_size;
     }
 
+  pass:
+    if (deadline) {
+      printf("pass with bites up to %zu\n", width);
+      fflush(stdout);
+      for (size_t i = 0; i < MAX_LENGTH; i++) {
+        bite_size[i] = min(full_bite_size[i], width);
+      }
+    }
+
+    chain_size = start_chain_length;
+    num_unfulfilled_targets = NUM_TARGETS;
+
+    // restore progress
+    if (start_indices_size > start_chain_length) {
+      while (chain_size < start_indices_size) {
+        if (chain_size > reused_size || chain_size >= restored_size) {
+          GENERATE_NEW_EXPRESSIONS
+        }
+        if (start_indices[chain_size] >= priorities[chain_size].size()) {
+          printf("choice %d at length %zu is beyond the %zu expressions\n",
+                 start_indices[chain_size], chain_size,
+                 priorities[chain_size].size());
+          restored_size = chain_size;
+          goto chunk_done;
+        }
+        choices[chain_size] = start_indices[chain_size];
+        chain[chain_size] =
+            expressions[chain_size]
+                       [priorities[chain_size][choices[chain_size]]];
+        RECORD_DERIVATION(
+            chain_derivations, chain_size,
+            expression_derivations[chain_size]
+                                  [priorities[chain_size][choices[chain_size]]])
+        num_unfulfilled_targets -= target_lookup[chain[chain_size]];
+        publish_choice(
+            chain_size, choices[chain_size],
+            min(bite_size[chain_size], priorities[chain_size].size()));
+        chain_size++;
+      }
+    }
     choices[chain_size] = 0;
-  }
+    // the levels below the prefix are still the last pass's or chunk's
+    for (size_t i = chain_size; i < MAX_LENGTH; i++) {
+      heartbeat_choices[i].store(0, std::memory_order_relaxed);
+    }
+    heartbeat_level.store(stop_chain_size, std::memory_order_relaxed);
+    heartbeat_first.store(stop_chain_size < start_indices_size
+                              ? start_indices[stop_chain_size]
+                              : 0,
+                          std::memory_order_relaxed);
+    publish_chains();
+
+    // without -c the search backtracks into the prefix and overwrites it
+    restored_size = stop_chain_size;
+
+    if (beam_width) {
+      beam_search(chain, chain_derivations, chain_size,
+                  num_unfulfilled_targets, limit, current_best_length);
+      if (deadline_reached) {
+        goto deadline_done;
+      }
+      goto chunk_done;
+    }
 
 start:
+    if (__builtin_expect(deadline_reached, 0)) {
+      goto deadline_done;
+    }
 
-  if (chain_size + num_unfulfilled_targets == MAX_LENGTH) {
-    memset(costs, 0xff, sizeof(costs));
-    generate_first_expressions(chain, chain_size, dummy_c);
-    bool found = false;
-    for (size_t i = 0; i < levels_size[1]; i++) {
-      const uint32_t f = levels[1][i];
-      if (target_lookup[f]) {
-        expressions[chain_size][0] = f;
-        priorities[chain_size].clear();
-        priorities[chain_size].push_back(0);
-        found = true;
-        break;
+#if EXHAUSTIVE_TAIL
+    if (chain_size + EXHAUSTIVE_TAIL >= limit) {
+      start_exhaustive_tail(chain, chain_derivations, chain_size,
+                            num_unfulfilled_targets, limit,
+                            current_best_length);
+      // a tail the deadline cut off is run again by the resumed search
+      if (__builtin_expect(deadline_reached, 0)) {
+        goto deadline_done;
       }
-    }
-    if (!found) {
       choices[chain_size] = 1 << 16;
+      goto next;
+    }
+#endif
+
+    if (chain_size + num_unfulfilled_targets >= limit) {
+      memset(costs, 0xff, sizeof(costs));
+      generate_first_expressions(chain, chain_size, dummy_c);
+      bool found = false;
+      for (size_t i = 0; i < levels_size[1]; i++) {
+        const uint32_t f = levels[1][i];
+        if (target_lookup[f]) {
+          expressions[chain_size][0] = f;
+          RECORD_DERIVATION(expression_derivations[chain_size], 0,
+                            first_derivations[i])
+          priorities[chain_size].clear();
+          priorities[chain_size].push_back(0);
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        choices[chain_size] = 1 << 16;
+      }
+    } else {
+      GENERATE_NEW_EXPRESSIONS
     }
-  } else {
-    GENERATE_NEW_EXPRESSIONS
-  }
 
 next:
-  if (choices[chain_size] < bite_size[chain_size] &&
-      choices[chain_size] < priorities[chain_size].size()) {
-    chain[chain_size] =
-        expressions[chain_size][priorities[chain_size][choices[chain_size]]];
+    // with a bound the limit can drop below the chain of an earlier node
+    if (choices[chain_size] < bite_size[chain_size] &&
+        choices[chain_size] < priorities[chain_size].size() &&
+        chain_size + num_unfulfilled_targets <= limit) {
+      chain[chain_size] =
+          expressions[chain_size][priorities[chain_size][choices[chain_size]]];
+      RECORD_DERIVATION(
+          chain_derivations, chain_size,
+          expression_derivations[chain_size]
+                                [priorities[chain_size][choices[chain_size]]])
+
+      total_chains++;
+      publish_chains();
+      publish_choice(chain_size, choices[chain_size],
+                     min(bite_size[chain_size], priorities[chain_size].size()));
+      if (__builtin_expect(chain_size <= 10, 0)) {
+        for (size_t j = start_chain_length; j < chain_size; ++j) {
+          printf("%d, ", choices[j]);
+        }
+        printf("%d [best: %zu] %" PRIu64 "\n", choices[chain_size],
+               current_best_length, total_chains);
+        fflush(stdout);
+      }
 
-    total_chains++;
-    if (__builtin_expect(chain_size <= 10, 0)) {
-      for (size_t j = start_chain_length; j < chain_size; ++j) {
-        printf("%d, ", choices[j]);
+      num_unfulfilled_targets -= target_lookup[chain[chain_size]];
+      if (__builtin_expect(chain_size + num_unfulfilled_targets >= limit, 0)) {
+        // no need to do this, as it must have been 0 to end up in this path
+        // num_unfulfilled_targets += target_lookup[chain[chain_size]];
+        choices[chain_size]++;
+        goto next;
       }
-      printf("%d [best: %zu] %" PRIu64 "\n", choices[chain_size],
-             current_best_length, total_chains);
-      fflush(stdout);
-    }
 
-    num_unfulfilled_targets -= target_lookup[chain[chain_size]];
-    if (__builtin_expect(chain_size + num_unfulfilled_targets >= MAX_LENGTH,
-                         0)) {
-      // no need to do this, as it must have been 0 to end up in this path
-      // num_unfulfilled_targets += target_lookup[chain[chain_size]];
-      choices[chain_size]++;
-      goto next;
+      if (__builtin_expect(!num_unfulfilled_targets, 0)) {
+        found_chain(chain, chain_derivations, chain_size + 1, limit,
+                    current_best_length);
+        // it must have been 1 to end up in this path, so we can just
+        // increment
+        // num_unfulfilled_targets += target_lookup[chain[chain_size]];
+        num_unfulfilled_targets++;
+        choices[chain_size]++;
+        goto next;
+      }
+
+      chain_size++;
+      choices[chain_size] = 0;
+      goto start;
     }
 
-    if (__builtin_expect(!num_unfulfilled_targets, 0)) {
-      print_chain(chain, chain_size + 1);
-      if (chain_size + 1 < current_best_length) {
-        current_best_length = chain_size + 1;
+    chain_size--;
+    num_unfulfilled_targets += target_lookup[chain[chain_size]];
+    // if it was a target function, then we can skip all other choices at this
+    // length, because the target function needs to be taken at some point,
+    // might as well be now
+    //
+    // the trick here is to simply add a large number to
+    // the choices at that level if target_lookup is 1, this avoids branching
+    choices[chain_size] += 1 + (target_lookup[chain[chain_size]] << 16);
+
+    if (__builtin_expect(chain_size < stop_chain_size, 0)) {
+      // the next pass starts over at the chunk, whose levels are still there
+      if (deadline && width < max_bite_size) {
+        width++;
+        start_indices_size = stop_chain_size;
+        reused_size = stop_chain_size;
+        goto pass;
       }
-      // it must have been 1 to end up in this path, so we can just increment
-      // num_unfulfilled_targets += target_lookup[chain[chain_size]];
-      num_unfulfilled_targets++;
-      choices[chain_size]++;
-      goto next;
+      goto chunk_done;
     }
 
-    chain_size++;
-    choices[chain_size] = 0;
-    goto start;
-  }
+    goto next;
 
-  chain_size--;
-  num_unfulfilled_targets += target_lookup[chain[chain_size]];
-  // if it was a target function, then we can skip all other choices at this
-  // length, because the target function needs to be taken at some point,
-  // might as well be now
-  //
-  // the trick here is to simply add a large number to
-  // the choices at that level if target_lookup is 1, this avoids branching
-  choices[chain_size] += 1 + (target_lookup[chain[chain_size]] << 16);
+deadline_done:
+    print_deadline(choices, chain_size, chunk_mode, stop_chain_size, width,
+                   limit);
+    chunk_cut = true;
 
-  if (__builtin_expect(chain_size < stop_chain_size, 0)) {
-    return 0;
+chunk_done:
+    heartbeat.end_chunk();
+    print_summary();
+    chunk_running = false;
+    if (chunk_wrapped) {
+      print_chunk_end(chunk_timer);
+    }
+    // a worker doesn't send a partial result, the coordinator leases the chunk
+    // again from the start
+    if (chunk_cut && chunk_source.worker.enabled()) {
+      chunk_source.worker.release_chunk();
+      break;
+    }
   }
 
-  goto next;
-
   return 0;
 }
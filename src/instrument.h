@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters for full-search's INSTRUMENT builds, read with
+// perf_event_open. The hardware events are opened as one group, so they count
+// over the same time, the task clock is a software event on its own, so it
+// also works in VMs and containers without a PMU. A counter that can't be
+// opened, e.g. with kernel.perf_event_paranoid > 2, or that isn't supported,
+// like a last level cache event on some ARM cores, is reported as
+// unavailable. The generic cache events have no L2, the last level is the
+// nearest one every PMU has.
+
+enum PerfCounter {
+  PERF_TASK_CLOCK,
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  NUM_PERF_COUNTERS
+};
+
+constexpr const char *PERF_COUNTER_NAMES[NUM_PERF_COUNTERS] = {
+    "task_clock_ns", "cycles",     "instructions",
+    "l1d_misses",    "llc_misses", "branch_misses",
+};
+
+struct PerfCounters {
+  int clock_fd = -1;
+  int group_fd = -1;
+  // the counters of the group, in the order of a group read
+  uint32_t group[NUM_PERF_COUNTERS];
+  uint32_t group_size = 0;
+  bool available[NUM_PERF_COUNTERS] = {false};
+
+#ifdef __linux__
+  static int open_event(const uint32_t type, const uint64_t config,
+                        const int group_fd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+  }
+
+  void open() {
+    clock_fd = open_event(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1);
+    available[PERF_TASK_CLOCK] = clock_fd >= 0;
+
+    const uint64_t l1d_read_miss =
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint64_t llc_read_miss =
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const struct {
+      PerfCounter counter;
+      uint32_t type;
+      uint64_t config;
+    } events[] = {
+        {PERF_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_L1D_MISSES, PERF_TYPE_HW_CACHE, l1d_read_miss},
+        {PERF_LLC_MISSES, PERF_TYPE_HW_CACHE, llc_read_miss},
+        {PERF_BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+    for (const auto &event : events) {
+      const int fd = open_event(event.type, event.config, group_fd);
+      if (fd < 0) {
+        continue;
+      }
+      if (group_fd < 0) {
+        group_fd = fd;
+      }
+      group[group_size++] = event.counter;
+      available[event.counter] = true;
+    }
+  }
+
+  // the counters since open, 0 for the unavailable ones
+  void read(uint64_t *values) {
+    memset(values, 0, sizeof(uint64_t) * NUM_PERF_COUNTERS);
+    // the number of counters, then their values
+    uint64_t buffer[1 + NUM_PERF_COUNTERS];
+    if (clock_fd >= 0 &&
+        ::read(clock_fd, buffer, sizeof(buffer)) >= (ssize_t)(2 * 8)) {
+      values[PERF_TASK_CLOCK] = buffer[1];
+    }
+    if (group_fd >= 0 && ::read(group_fd, buffer, sizeof(buffer)) >=
+                             (ssize_t)((1 + group_size) * 8)) {
+      for (uint32_t i = 0; i < group_size; i++) {
+        values[group[i]] = buffer[1 + i];
+      }
+    }
+  }
+#else
+  void open() {}
+  void read(uint64_t *values) {
+    memset(values, 0, sizeof(uint64_t) * NUM_PERF_COUNTERS);
+  }
+#endif
+};
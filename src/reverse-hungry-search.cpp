@@ -1,4 +1,5 @@
 #include "bit_set_fast.h"
+#include "footprint_priorities.h"
 #include <algorithm>
 #include <bitset>
 #include <cstdint>
@@ -29,7 +30,11 @@ BitSet footprints[SIZE];
 uint32_t costs[SIZE] __attribute__((aligned(64))) = {0};
 uint32_t levels[50][50000];
 size_t levels_size[10] = {0};
-uint32_t frequencies[50000];
+// index of each function in its level, only set for the levels from 2 on, the
+// chain and the first expressions never get a lower cost
+uint32_t level_positions[SIZE];
+// the sort key of every first expression, see get_priority
+uint32_t priority_keys[50000];
 uint32_t target_lookup[SIZE] __attribute__((aligned(64))) = {0};
 
 #define ADD_FIRST_EXPRESSION(value)                                            \
@@ -61,16 +66,13 @@ uint32_t target_lookup[SIZE] __attribute__((aligned(64))) = {0};
   sort(priorities[chain_size].begin(), priorities[chain_size].end(),           \
        [&](size_t x, size_t y) { return get_priority(x) < get_priority(y); });
 
+// moves the last function of the level into the gap
 void erase(uint32_t *array, size_t &array_size, uint32_t f) {
-  for (size_t i = 0; i < array_size; i++) {
-    if (array[i] == f) {
-      if (i < array_size - 1) {
-        array[i] = array[array_size - 1];
-      }
-      array_size--;
-      return;
-    }
-  }
+  const uint32_t i = level_positions[f];
+  const uint32_t last = array[array_size - 1];
+  array[i] = last;
+  level_positions[last] = i;
+  array_size--;
 }
 
 void generate_first_expressions(const uint32_t *chain, const size_t chain_size,
@@ -158,6 +160,7 @@ void algorithm_l_with_footprints(const uint32_t *chain,
                {g & h, not_g & h, g & not_h, g | h, g ^ h}) {
             if (costs[f] == 0xffffffff) {
               costs[f] = u;
+              level_positions[f] = levels_size[u];
               levels[u][levels_size[u]] = f;
               levels_size[u]++;
               footprints[f] = v;
@@ -166,6 +169,7 @@ void algorithm_l_with_footprints(const uint32_t *chain,
               const uint32_t previous_u = costs[f];
               erase(levels[previous_u], levels_size[previous_u], f);
               costs[f] = u;
+              level_positions[f] = levels_size[u];
               levels[u][levels_size[u]] = f;
               levels_size[u]++;
               footprints[f] = v;
@@ -179,28 +183,14 @@ void algorithm_l_with_footprints(const uint32_t *chain,
   }
 }
 
+// see src/footprint_priorities.h
 void count_first_expressions_in_footprints(const uint32_t expressions_size) {
-  memset(frequencies, 0, sizeof(uint32_t) * expressions_size);
-
-  for (const uint32_t &f : TARGETS) {
-    for (size_t i = 0; i < expressions_size; i++) {
-      if (footprints[f].get(i)) {
-        frequencies[i]++;
-      }
-    }
-  }
+  footprint_priority_keys<NUM_TARGETS>(footprints, costs, TARGETS,
+                                       priority_keys, expressions_size);
 }
 
-auto get_priority(const size_t index) {
-  int min_value = 1000;
-  for (const auto &y : TARGETS) {
-    if (footprints[y].get(index)) {
-      min_value = min(min_value, static_cast<int>(costs[y]));
-    }
-  }
-  return make_tuple(min_value, -static_cast<int>(frequencies[index]),
-                    -static_cast<int>(index));
-};
+// orders like the tuple (lowest target cost, -frequency, -index)
+uint32_t get_priority(const size_t index) { return priority_keys[index]; }
 
 int main(int argc, char *argv[]) {
   uint32_t dummy_c = 0;
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// The 7-segment display on all 16 rows of the 4 inputs, the first row is the
+// digit 0. The segments a-f are negated, so that the first row of every target
+// is 0 like for every function the searches generate. With fewer rows, e.g.
+// only the digits 0-9 for N = 10, the targets are the first N rows,
+// SEGMENT_TARGETS[i] >> (16 - N).
+
+constexpr uint32_t SEGMENT_TARGETS[] = {
+    ~(uint32_t)0b1011011111100011 & 0xffff,
+    ~(uint32_t)0b1111100111100100 & 0xffff,
+    ~(uint32_t)0b1101111111110100 & 0xffff,
+    ~(uint32_t)0b1011011011011110 & 0xffff,
+    ~(uint32_t)0b1010001010111111 & 0xffff,
+    ~(uint32_t)0b1000111111110011 & 0xffff,
+    (uint32_t)0b0011111011111111,
+};
+constexpr uint32_t NUM_SEGMENT_TARGETS =
+    sizeof(SEGMENT_TARGETS) / sizeof(SEGMENT_TARGETS[0]);
+
+// the names the release chains use, see analyze-chains.py
+constexpr const char *SEGMENT_NAMES[] = {"~a", "~b", "~c", "~d",
+                                         "~e", "~f", "g"};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Binary store for the chains of full-search's COLLECT_ALL mode. The file
+// starts with a SolutionsHeader, followed by fixed size records, so runs can
+// append to the same file and tools can seek to any record. The header gives
+// the layout of the records, a BCSOLS2 record packs
+//   uint8_t length, num_inputs, target_set
+//   the functions, max_length words of function_bytes, little endian
+//   the ops, max_length bytes
+//   the operands, max_length pairs of bytes
+// with words just wide enough for N and room for the chains of the build's
+// MAX_LENGTH, e.g. 113 bytes for N = 16 and MAX_LENGTH = 22. The older
+// BCSOLS1 files hold SolutionRecords as they are, with every function as a
+// uint64_t and room for MAX_SOLUTION_LENGTH of them. src/dump-solutions.cpp
+// prints the records of both in print_chain's format.
+
+constexpr char SOLUTIONS_MAGIC_V1[8] = "BCSOLS1";
+constexpr char SOLUTIONS_MAGIC[8] = "BCSOLS2";
+constexpr uint32_t MAX_SOLUTION_LENGTH = 32;
+
+struct SolutionsHeader {
+  char magic[8];
+  // the width of the truth tables
+  uint32_t n;
+  uint32_t record_size;
+  // not in BCSOLS1 files, whose header ends here
+  uint32_t max_length;
+  uint32_t function_bytes;
+};
+constexpr size_t SOLUTIONS_HEADER_V1_SIZE = 16;
+
+// a chain as the tools use it, and the record of BCSOLS1 files
+struct SolutionRecord {
+  uint64_t functions[MAX_SOLUTION_LENGTH];
+  // the derivation that generated every function, op is one of & | ^ < >
+  // like in print_chain, or 0 for the inputs, operands are indices into
+  // functions
+  uint8_t ops[MAX_SOLUTION_LENGTH];
+  uint8_t operands[MAX_SOLUTION_LENGTH][2];
+  uint8_t length;
+  uint8_t num_inputs;
+  // the index of the target set with TARGET_SETS_HEADER, 0 otherwise
+  uint8_t target_set;
+  uint8_t padding[5];
+};
+static_assert(sizeof(SolutionRecord) == 360, "the BCSOLS1 record is fixed");
+
+uint32_t solution_function_bytes(const uint32_t n) {
+  return n <= 8 ? 1 : n <= 16 ? 2 : n <= 32 ? 4 : 8;
+}
+
+uint32_t solution_record_size(const uint32_t max_length,
+                              const uint32_t function_bytes) {
+  return 3 + max_length * (function_bytes + 3);
+}
+
+SolutionsHeader new_solutions_header(const uint32_t n,
+                                     const uint32_t max_length) {
+  SolutionsHeader header;
+  memcpy(header.magic, SOLUTIONS_MAGIC, sizeof(header.magic));
+  header.n = n;
+  header.max_length = max_length;
+  header.function_bytes = solution_function_bytes(n);
+  header.record_size = solution_record_size(max_length, header.function_bytes);
+  return header;
+}
+
+// reads the header of either format, a BCSOLS1 header gets the layout of its
+// records filled in, returns false if it isn't a solutions file
+bool read_solutions_header(FILE *file, SolutionsHeader &header) {
+  if (fread(&header, SOLUTIONS_HEADER_V1_SIZE, 1, file) != 1) {
+    return false;
+  }
+  if (memcmp(header.magic, SOLUTIONS_MAGIC_V1, sizeof(header.magic)) == 0) {
+    header.max_length = MAX_SOLUTION_LENGTH;
+    header.function_bytes = sizeof(uint64_t);
+    return header.record_size == sizeof(SolutionRecord);
+  }
+  return memcmp(header.magic, SOLUTIONS_MAGIC, sizeof(header.magic)) == 0 &&
+         fread(&header.max_length,
+               sizeof(header) - SOLUTIONS_HEADER_V1_SIZE, 1, file) == 1 &&
+         header.max_length <= MAX_SOLUTION_LENGTH &&
+         header.function_bytes <= sizeof(uint64_t) &&
+         header.record_size ==
+             solution_record_size(header.max_length, header.function_bytes);
+}
+
+bool is_solutions_v1(const SolutionsHeader &header) {
+  return memcmp(header.magic, SOLUTIONS_MAGIC_V1, sizeof(header.magic)) == 0;
+}
+
+// the record of a BCSOLS2 file, which has room for the length of the chain
+void pack_solution(const SolutionRecord &record, const SolutionsHeader &header,
+                   uint8_t *bytes) {
+  memset(bytes, 0, header.record_size);
+  bytes[0] = record.length;
+  bytes[1] = record.num_inputs;
+  bytes[2] = record.target_set;
+  uint8_t *functions = bytes + 3;
+  uint8_t *ops = functions + header.max_length * header.function_bytes;
+  uint8_t *operands = ops + header.max_length;
+  for (uint32_t i = 0; i < record.length; i++) {
+    for (uint32_t b = 0; b < header.function_bytes; b++) {
+      functions[i * header.function_bytes + b] = record.functions[i] >> (8 * b);
+    }
+    ops[i] = record.ops[i];
+    operands[2 * i] = record.operands[i][0];
+    operands[2 * i + 1] = record.operands[i][1];
+  }
+}
+
+void unpack_solution(const uint8_t *bytes, const SolutionsHeader &header,
+                     SolutionRecord &record) {
+  if (is_solutions_v1(header)) {
+    memcpy(&record, bytes, sizeof(record));
+    return;
+  }
+
+  memset(&record, 0, sizeof(record));
+  record.length = bytes[0];
+  record.num_inputs = bytes[1];
+  record.target_set = bytes[2];
+  const uint8_t *functions = bytes + 3;
+  const uint8_t *ops = functions + header.max_length * header.function_bytes;
+  const uint8_t *operands = ops + header.max_length;
+  for (uint32_t i = 0; i < record.length && i < header.max_length; i++) {
+    for (uint32_t b = 0; b < header.function_bytes; b++) {
+      record.functions[i] |=
+          uint64_t(functions[i * header.function_bytes + b]) << (8 * b);
+    }
+    record.ops[i] = ops[i];
+    record.operands[i][0] = operands[2 * i];
+    record.operands[i][1] = operands[2 * i + 1];
+  }
+}
+
+// opens the file for appending and writes the header if it's new, returns
+// nullptr if the file can't be opened, is in the BCSOLS1 format, belongs to a
+// different N or has no room for chains of max_length, the records are packed
+// with the file's header
+FILE *open_solutions(const char *path, const uint32_t n,
+                     const uint32_t max_length, SolutionsHeader &header) {
+  FILE *file = fopen(path, "ab+");
+  if (file == nullptr) {
+    printf("couldn't open solutions file %s\n", path);
+    return nullptr;
+  }
+
+  fseek(file, 0, SEEK_END);
+  if (ftell(file) == 0) {
+    header = new_solutions_header(n, max_length);
+    fwrite(&header, sizeof(header), 1, file);
+    return file;
+  }
+
+  fseek(file, 0, SEEK_SET);
+  if (!read_solutions_header(file, header) || is_solutions_v1(header) ||
+      header.n != n || header.max_length < max_length ||
+      header.function_bytes < solution_function_bytes(n)) {
+    printf("solutions file %s has a different format or N\n", path);
+    fclose(file);
+    return nullptr;
+  }
+  return file;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Truth tables are N bits wide, one bit per row of the inputs, the first row
+// is the most significant bit. Up to N = 32 they fit into a uint32_t, up to
+// N = 64, i.e. 6 inputs, into a uint64_t.
+//
+// The searches normalise the functions so that the first row is 0, which
+// keeps every function below 1 << (N - 1). Up to UNSEEN_DIRECT_MAX_N, the flags
+// of all these functions fit into a directly indexed array, e.g. 32 KiB at
+// N = 16, beyond that only the functions whose flags differ from the default
+// are kept in a small hash table. The chains only ever touch a few thousand
+// functions, so the table stays sparse.
+
+#ifndef UNSEEN_DIRECT_MAX_N
+#define UNSEEN_DIRECT_MAX_N 20
+#endif
+
+template <uint32_t N>
+using truth_table_t = std::conditional_t<
+    (N <= 32), uint32_t, std::conditional_t<(N <= 64), uint64_t, void>>;
+
+// the number of input variables for N rows
+constexpr uint32_t num_inputs(const uint32_t n) {
+  uint32_t inputs = 0;
+  while ((1u << inputs) < n) {
+    inputs++;
+  }
+  return inputs;
+}
+
+// the truth table of input k of inputs, restricted to the first n rows, e.g.
+// for n = 16: 0b0000000011111111, 0b0000111100001111, ..., 0b0101010101010101
+template <typename word_t>
+constexpr word_t input_truth_table(const uint32_t k, const uint32_t inputs,
+                                   const uint32_t n) {
+  word_t table = 0;
+  for (uint32_t row = 0; row < n; row++) {
+    table |= (word_t)((row >> (inputs - 1 - k)) & 1) << (n - 1 - row);
+  }
+  return table;
+}
+
+// open addressing with linear probing, an entry is removed as soon as its
+// flags are back to the default, so the table never fills up
+template <typename word_t> struct HashedUnseen {
+  static constexpr uint32_t BITS = 13;
+  static constexpr uint32_t CAPACITY = 1 << BITS;
+  static constexpr uint32_t MASK = CAPACITY - 1;
+  // never a key, the first row of every function is 0
+  static constexpr word_t EMPTY = ~(word_t)0;
+
+  word_t keys[CAPACITY];
+  uint8_t values[CAPACITY];
+  uint8_t default_value;
+
+  struct Ref {
+    HashedUnseen &unseen;
+    const word_t f;
+
+    operator uint8_t() const { return unseen.get(f); }
+    Ref &operator=(const uint8_t value) {
+      unseen.set(f, value);
+      return *this;
+    }
+    Ref &operator|=(const uint8_t value) {
+      unseen.set(f, unseen.get(f) | value);
+      return *this;
+    }
+  };
+
+  static uint32_t slot(const word_t f) {
+    return (uint32_t)(((uint64_t)f * 0x9e3779b97f4a7c15ull) >> (64 - BITS));
+  }
+
+  uint32_t find(const word_t f) const {
+    uint32_t i = slot(f);
+    while (keys[i] != EMPTY && keys[i] != f) {
+      i = (i + 1) & MASK;
+    }
+    return i;
+  }
+
+  uint8_t get(const word_t f) const {
+    const uint32_t i = find(f);
+    return keys[i] == f ? values[i] : default_value;
+  }
+
+  void set(const word_t f, const uint8_t value) {
+    uint32_t i = find(f);
+    if (keys[i] != f) {
+      if (value != default_value) {
+        keys[i] = f;
+        values[i] = value;
+      }
+      return;
+    }
+    if (value != default_value) {
+      values[i] = value;
+      return;
+    }
+
+    // shift the following entries back, so no probe sequence has a gap
+    uint32_t j = i;
+    while (true) {
+      j = (j + 1) & MASK;
+      if (keys[j] == EMPTY) {
+        break;
+      }
+      const uint32_t home = slot(keys[j]);
+      if (((j - home) & MASK) >= ((j - i) & MASK)) {
+        keys[i] = keys[j];
+        values[i] = values[j];
+        i = j;
+      }
+    }
+    keys[i] = EMPTY;
+  }
+
+  void fill(const uint8_t value) {
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+      keys[i] = EMPTY;
+    }
+    default_value = value;
+  }
+  Ref operator[](const word_t f) { return Ref{*this, f}; }
+  uint8_t operator[](const word_t f) const { return get(f); }
+};
+
+// the direct flags stay a plain array and are passed as a pointer, wrapping
+// them in a struct makes gcc's code for the DFS measurably slower
+template <typename word_t, uint32_t N>
+using unseen_t =
+    std::conditional_t<(N <= UNSEEN_DIRECT_MAX_N),
+                       uint8_t[(N <= UNSEEN_DIRECT_MAX_N) ? 1 << (N - 1) : 1],
+                       HashedUnseen<word_t>>;
+
+// what the functions take, uint8_t * or HashedUnseen &
+template <typename Unseen>
+using unseen_ref_t = std::conditional_t<std::is_array_v<Unseen>,
+                                        std::decay_t<Unseen>, Unseen &>;
+template <typename Unseen>
+using const_unseen_ref_t =
+    std::conditional_t<std::is_array_v<Unseen>,
+                       std::decay_t<const Unseen>, const Unseen &>;
+
+template <typename Unseen>
+void fill_unseen(Unseen &unseen, const uint8_t value) {
+  if constexpr (std::is_array_v<Unseen>) {
+    memset(unseen, value, sizeof(unseen));
+  } else {
+    unseen.fill(value);
+  }
+}
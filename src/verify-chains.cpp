@@ -0,0 +1,433 @@
+#include "segment_targets.h"
+#include "truth_table.h"
+#include <algorithm>
+#include <bitset>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// verifies and deduplicates the chains in the output of the searches, the
+// release files and dump-solutions, e.g.
+//   verify-chains publish/release/chains-*.txt
+//   verify-chains -p output.txt > unique.txt   also print the unique chains
+//   full-search ... | verify-chains             from stdin
+//
+// A chain is a block of consecutive lines "xi = xj op xk = <bits>", the 4
+// inputs are "xi = <bits>". Every chain is evaluated on all 16 rows of its
+// inputs, every derivation and the printed bits, and the full truth table in
+// brackets if there is one, must match, and all 7-segment targets must be in
+// the chain. The valid chains are canonicalised, the same expressions added
+// in a different order or with the operands swapped are the same chain, and
+// only the first one is counted as unique.
+
+constexpr uint32_t ROWS = 16;
+constexpr uint32_t INPUTS = 4;
+constexpr uint32_t MAX_CHAIN_SIZE = 64;
+
+struct Step {
+  // 0 for the inputs
+  char op;
+  uint8_t j;
+  uint8_t k;
+  uint32_t function;
+};
+
+struct Chain {
+  // lines[first] to lines[first + size - 1]
+  uint32_t first;
+  uint32_t size;
+  std::string error;
+  // n, then op, j, k for every expression in the canonical order
+  std::string key;
+  Step steps[MAX_CHAIN_SIZE];
+  uint32_t rows;
+};
+
+struct Line {
+  std::string_view text;
+  uint32_t file;
+  uint32_t number;
+};
+
+std::vector<std::string> file_names;
+std::vector<std::string> file_data;
+std::vector<Line> lines;
+
+bool is_step(const std::string_view line) {
+  size_t i = line.find_first_not_of(' ');
+  return i != std::string_view::npos && i + 1 < line.size() &&
+         line[i] == 'x' && line[i + 1] >= '0' && line[i + 1] <= '9';
+}
+
+uint32_t parse_number(const std::string_view s, size_t &i) {
+  uint32_t value = 0;
+  while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+    value = value * 10 + (s[i] - '0');
+    i++;
+  }
+  return value;
+}
+
+uint32_t parse_bits(const std::string_view s, size_t &i, uint32_t &width) {
+  uint32_t value = 0;
+  width = 0;
+  while (i < s.size() && (s[i] == '0' || s[i] == '1')) {
+    value = (value << 1) | (s[i] - '0');
+    width++;
+    i++;
+  }
+  return value;
+}
+
+bool starts_with(const std::string_view s, const size_t i, const char *t) {
+  return s.substr(i, strlen(t)) == t;
+}
+
+uint32_t apply(const char op, const uint32_t g, const uint32_t h) {
+  switch (op) {
+  case '&':
+    return g & h;
+  case '|':
+    return g | h;
+  case '^':
+    return g ^ h;
+  case '<':
+    return ~g & h;
+  case '>':
+    return g & ~h;
+  }
+  return 0;
+}
+
+// returns false and sets the error if the line isn't a valid step i
+bool verify_step(Chain &chain, const uint32_t i, const std::string_view s) {
+  char message[128];
+  size_t p = s.find('x') + 1;
+  if (parse_number(s, p) != i + 1) {
+    snprintf(message, sizeof(message), "x%d expected", i + 1);
+    chain.error = message;
+    return false;
+  }
+
+  const uint32_t full_mask = (1 << ROWS) - 1;
+  Step &step = chain.steps[i];
+  step.op = 0;
+  uint32_t full = 0;
+  uint32_t differs = 0;
+  while (starts_with(s, p, " = x")) {
+    p += 4;
+    const uint32_t j = parse_number(s, p);
+    if (p + 3 > s.size() || s[p] != ' ' || !strchr("&|^<>", s[p + 1]) ||
+        s[p + 2] != ' ' || s[p + 3] != 'x') {
+      chain.error = "invalid derivation";
+      return false;
+    }
+    const char op = s[p + 1];
+    p += 4;
+    const uint32_t k = parse_number(s, p);
+    if (j < 1 || j > i || k < 1 || k > i || j == k) {
+      chain.error = "operand out of range";
+      return false;
+    }
+
+    // the first derivation gives the function, the others only need to
+    // match on the rows that are printed
+    const uint32_t f =
+        apply(op, chain.steps[j - 1].function, chain.steps[k - 1].function) &
+        full_mask;
+    differs |= f ^ full;
+    if (!step.op) {
+      step.op = op;
+      step.j = j - 1;
+      step.k = k - 1;
+      full = f;
+      differs = 0;
+    }
+  }
+
+  if (!step.op) {
+    if (i >= INPUTS) {
+      chain.error = "input after the first 4 steps";
+      return false;
+    }
+    full = input_truth_table<uint32_t>(i, INPUTS, ROWS);
+  } else if (i < INPUTS) {
+    chain.error = "expression before the inputs";
+    return false;
+  }
+  step.function = full;
+
+  uint32_t width;
+  if (!starts_with(s, p, " = ")) {
+    chain.error = "no bits";
+    return false;
+  }
+  p += 3;
+  const uint32_t bits = parse_bits(s, p, width);
+  if (width == 0 || width > ROWS || (i && width != chain.rows)) {
+    chain.error = "invalid number of bits";
+    return false;
+  }
+  chain.rows = width;
+  if (bits != full >> (ROWS - width)) {
+    chain.error = "bits don't match the derivation";
+    return false;
+  }
+  if (differs >> (ROWS - width)) {
+    chain.error = "derivations differ";
+    return false;
+  }
+
+  if (starts_with(s, p, " [0") || starts_with(s, p, " [1")) {
+    p += 2;
+    const uint32_t full_bits = parse_bits(s, p, width);
+    if (width != ROWS || full_bits != full) {
+      chain.error = "full truth table doesn't match the derivation";
+      return false;
+    }
+  }
+  return true;
+}
+
+// orders the expressions by their functions, every expression after the ones
+// it depends on, and renames the operands, so j < k
+void canonicalise(Chain &chain) {
+  const uint32_t size = chain.size;
+  uint32_t position[MAX_CHAIN_SIZE];
+  bool placed[MAX_CHAIN_SIZE] = {false};
+  uint32_t order[MAX_CHAIN_SIZE];
+  for (uint32_t i = 0; i < INPUTS; i++) {
+    position[i] = i;
+    placed[i] = true;
+    order[i] = i;
+  }
+
+  for (uint32_t next = INPUTS; next < size; next++) {
+    uint32_t best = size;
+    for (uint32_t i = INPUTS; i < size; i++) {
+      const Step &step = chain.steps[i];
+      if (placed[i] || !placed[step.j] || !placed[step.k]) {
+        continue;
+      }
+      if (best == size || step.function < chain.steps[best].function) {
+        best = i;
+      }
+    }
+    placed[best] = true;
+    position[best] = next;
+    order[next] = best;
+  }
+
+  chain.key.clear();
+  chain.key.push_back((char)chain.rows);
+  Step canonical[MAX_CHAIN_SIZE];
+  for (uint32_t i = 0; i < size; i++) {
+    Step step = chain.steps[order[i]];
+    if (step.op) {
+      step.j = position[step.j];
+      step.k = position[step.k];
+      if (step.j > step.k) {
+        std::swap(step.j, step.k);
+        step.op = step.op == '<' ? '>' : step.op == '>' ? '<' : step.op;
+      }
+    }
+    canonical[i] = step;
+    chain.key.push_back(step.op);
+    chain.key.push_back((char)step.j);
+    chain.key.push_back((char)step.k);
+  }
+  memcpy(chain.steps, canonical, sizeof(Step) * size);
+}
+
+void verify_chain(Chain &chain) {
+  if (chain.size > MAX_CHAIN_SIZE) {
+    chain.error = "chain too long";
+    return;
+  }
+  if (chain.size < INPUTS) {
+    chain.error = "fewer than 4 inputs";
+    return;
+  }
+  for (uint32_t i = 0; i < chain.size; i++) {
+    if (!verify_step(chain, i, lines[chain.first + i].text)) {
+      return;
+    }
+  }
+
+  for (uint32_t t = 0; t < NUM_SEGMENT_TARGETS; t++) {
+    const uint32_t target = SEGMENT_TARGETS[t] >> (ROWS - chain.rows);
+    bool found = false;
+    for (uint32_t i = 0; i < chain.size && !found; i++) {
+      found = chain.steps[i].function >> (ROWS - chain.rows) == target;
+    }
+    if (!found) {
+      chain.error = std::string("target ") + SEGMENT_NAMES[t] + " missing";
+      return;
+    }
+  }
+
+  canonicalise(chain);
+}
+
+void print_chain(const Chain &chain) {
+  printf("chain (%d):\n", chain.size);
+  for (uint32_t i = 0; i < chain.size; i++) {
+    const Step &step = chain.steps[i];
+    const uint32_t f = step.function >> (ROWS - chain.rows);
+    printf("x%d", i + 1);
+    if (step.op) {
+      printf(" = x%d %c x%d", step.j + 1, step.op, step.k + 1);
+    }
+    printf(" = %s", std::bitset<ROWS>(f).to_string().c_str() + ROWS -
+                        chain.rows);
+    for (uint32_t t = 0; t < NUM_SEGMENT_TARGETS; t++) {
+      if (f == SEGMENT_TARGETS[t] >> (ROWS - chain.rows)) {
+        printf(" [target]");
+        break;
+      }
+    }
+    printf("\n");
+  }
+  printf("\n");
+}
+
+void read_file(const char *name, FILE *file) {
+  std::string data;
+  char buffer[1 << 16];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.append(buffer, size);
+  }
+  file_names.push_back(name);
+  file_data.push_back(std::move(data));
+}
+
+int main(int argc, char *argv[]) {
+  bool print_unique = false;
+  uint32_t num_threads = std::thread::hardware_concurrency();
+  int arg = 1;
+  while (arg < argc) {
+    if (strcmp(argv[arg], "-p") == 0) {
+      print_unique = true;
+      arg++;
+    } else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+      num_threads = atoi(argv[arg + 1]);
+      arg += 2;
+    } else if (strcmp(argv[arg], "-h") == 0) {
+      printf("usage: %s [-p] [-j <threads>] [files...]\n", argv[0]);
+      return 0;
+    } else {
+      break;
+    }
+  }
+  num_threads = std::max(num_threads, 1u);
+
+  if (arg == argc) {
+    read_file("stdin", stdin);
+  }
+  for (; arg < argc; arg++) {
+    FILE *file = fopen(argv[arg], "rb");
+    if (file == nullptr) {
+      printf("couldn't open %s\n", argv[arg]);
+      return -1;
+    }
+    read_file(argv[arg], file);
+    fclose(file);
+  }
+
+  // the data doesn't move anymore, the lines point into it
+  for (uint32_t f = 0; f < file_data.size(); f++) {
+    const std::string_view data = file_data[f];
+    uint32_t number = 1;
+    size_t start = 0;
+    while (start < data.size()) {
+      size_t end = data.find('\n', start);
+      if (end == std::string_view::npos) {
+        end = data.size();
+      }
+      std::string_view text = data.substr(start, end - start);
+      if (!text.empty() && text.back() == '\r') {
+        text.remove_suffix(1);
+      }
+      lines.push_back({text, f, number++});
+      start = end + 1;
+    }
+  }
+
+  std::vector<Chain> chains;
+  for (uint32_t i = 0; i < lines.size();) {
+    if (!is_step(lines[i].text)) {
+      i++;
+      continue;
+    }
+    uint32_t end = i;
+    while (end < lines.size() && lines[end].file == lines[i].file &&
+           is_step(lines[end].text)) {
+      end++;
+    }
+    chains.emplace_back();
+    chains.back().first = i;
+    chains.back().size = end - i;
+    i = end;
+  }
+
+  // every thread takes every num_threads-th chain, the chains are about the
+  // same size
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&chains, t, num_threads]() {
+      for (size_t i = t; i < chains.size(); i += num_threads) {
+        verify_chain(chains[i]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // in the order of the input, so the first of every chain is kept
+  std::unordered_set<std::string> seen;
+  uint64_t num_invalid = 0;
+  uint64_t num_unique[MAX_CHAIN_SIZE + 1] = {0};
+  uint64_t num_valid[MAX_CHAIN_SIZE + 1] = {0};
+  for (const Chain &chain : chains) {
+    if (!chain.error.empty()) {
+      num_invalid++;
+      const Line &line = lines[chain.first];
+      fprintf(stderr, "%s:%d: invalid chain: %s\n",
+              file_names[line.file].c_str(), line.number,
+              chain.error.c_str());
+      continue;
+    }
+    num_valid[chain.size]++;
+    if (!seen.insert(chain.key).second) {
+      continue;
+    }
+    num_unique[chain.size]++;
+    if (print_unique) {
+      print_chain(chain);
+    }
+  }
+
+  uint64_t total_valid = 0;
+  for (uint32_t size = 0; size <= MAX_CHAIN_SIZE; size++) {
+    total_valid += num_valid[size];
+  }
+  printf("chains: %zu, valid: %" PRIu64 ", invalid: %" PRIu64
+         ", unique: %zu\n",
+         chains.size(), total_valid, num_invalid, seen.size());
+  for (uint32_t size = 0; size <= MAX_CHAIN_SIZE; size++) {
+    if (num_valid[size]) {
+      printf("length %d: %" PRIu64 " valid, %" PRIu64 " unique\n", size,
+             num_valid[size], num_unique[size]);
+    }
+  }
+  return num_invalid ? 1 : 0;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "chunks.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <netdb.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// --worker <host>:<port> takes the chunks from a coordinator, see
+// src/bin/coordinator.rs, instead of the arguments. The worker leases one
+// chunk at a time, runs it with its output wrapped like for several chunks,
+// sends that output back as the chunk's result and leases the next one, until
+// the coordinator has no chunks left. Every request is one connection, the
+// coordinator closes it after the reply:
+//   LEASE <worker>                   -> CHUNK <lease> <chunk> | WAIT <secs>
+//                                       | DONE
+//   RESULT <lease> <bytes>\n<output> -> OK | STALE | FAILED <reason>
+//   RELEASE <lease>                  -> OK | STALE
+//   FAIL <lease> <reason>            -> OK | STALE
+// A worker that dies keeps its lease until it times out, then the chunk goes
+// to the next worker that asks. A result for a chunk that another worker
+// already finished is STALE and dropped. A chunk the search can't run, e.g.
+// with the wrong number of indices, FAILs, the coordinator doesn't lease it
+// again and it gets no result, like one whose output is too large for the
+// coordinator. A chunk that a deadline or a signal cuts off is RELEASEd, the
+// next worker that asks runs it from the start.
+
+#define WORKER_RETRIES 30
+#define WORKER_RETRY_SECONDS 10
+
+#ifdef MSG_NOSIGNAL
+#define WORKER_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define WORKER_SEND_FLAGS 0
+#endif
+
+struct Worker {
+  std::string host;
+  std::string port;
+  std::string name;
+  // of the running chunk, empty if there is none
+  std::string lease;
+  // stdout goes to output while a chunk runs
+  int saved_stdout = -1;
+  FILE *output = nullptr;
+
+  bool enabled() const { return !host.empty(); }
+
+  // consumes --worker <host>:<port>
+  bool parse_arg(const int argc, char *argv[], int &arg) {
+    if (arg + 1 >= argc || strcmp(argv[arg], "--worker") != 0) {
+      return false;
+    }
+    const std::string address = argv[arg + 1];
+    const size_t colon = address.rfind(':');
+    host = address.substr(0, colon);
+    port = colon == std::string::npos ? "7878" : address.substr(colon + 1);
+    char hostname[256] = "worker";
+    gethostname(hostname, sizeof(hostname) - 1);
+    name = std::string(hostname) + "-" + std::to_string(getpid());
+    arg += 2;
+    return true;
+  }
+
+  int connect_coordinator() const {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+      return -1;
+    }
+    int fd = -1;
+    for (addrinfo *a = addresses; a != nullptr; a = a->ai_next) {
+      fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (fd < 0) {
+        continue;
+      }
+      if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+        break;
+      }
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(addresses);
+    return fd;
+  }
+
+  // retried while the coordinator can't be reached, false if it never answers
+  bool request(const std::string &message, std::string &reply) const {
+    for (uint32_t attempt = 0; attempt < WORKER_RETRIES; attempt++) {
+      if (attempt) {
+        sleep(WORKER_RETRY_SECONDS);
+      }
+      const int fd = connect_coordinator();
+      if (fd < 0) {
+        continue;
+      }
+      size_t sent = 0;
+      while (sent < message.size()) {
+        const ssize_t n = send(fd, message.data() + sent,
+                               message.size() - sent, WORKER_SEND_FLAGS);
+        if (n <= 0) {
+          break;
+        }
+        sent += n;
+      }
+      reply.clear();
+      char buffer[4096];
+      ssize_t n;
+      while (sent == message.size() &&
+             (n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        reply.append(buffer, n);
+      }
+      close(fd);
+      if (!reply.empty()) {
+        return true;
+      }
+    }
+    fprintf(stderr, "worker: no answer from the coordinator at %s:%s\n",
+            host.c_str(), port.c_str());
+    return false;
+  }
+
+  // false when the coordinator is done or can't be reached
+  bool lease_chunk(ChunkArgs &args) {
+    std::string reply;
+    while (request("LEASE " + name + "\n", reply)) {
+      if (strncmp(reply.c_str(), "WAIT ", 5) == 0) {
+        sleep(atoi(reply.c_str() + 5));
+        continue;
+      }
+      if (strncmp(reply.c_str(), "CHUNK ", 6) != 0) {
+        return false;
+      }
+      args.clear();
+      char *line = reply.data() + 6;
+      for (char *token = strtok(line, " \t\r\n"); token != nullptr;
+           token = strtok(nullptr, " \t\r\n")) {
+        if (lease.empty()) {
+          lease = token;
+        } else {
+          args.push_back(token);
+        }
+      }
+      fflush(stdout);
+      saved_stdout = dup(STDOUT_FILENO);
+      output = tmpfile();
+      dup2(fileno(output), STDOUT_FILENO);
+      return true;
+    }
+    return false;
+  }
+
+  // restores stdout and returns what the chunk printed
+  std::string end_capture() {
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    std::string data;
+    char buffer[4096];
+    size_t n;
+    rewind(output);
+    while ((n = fread(buffer, 1, sizeof(buffer), output)) > 0) {
+      data.append(buffer, n);
+    }
+    fclose(output);
+    return data;
+  }
+
+  // sends the output of the running chunk, it's also printed as usual
+  void finish_chunk() {
+    if (lease.empty()) {
+      return;
+    }
+    const std::string data = end_capture();
+    fwrite(data.data(), 1, data.size(), stdout);
+    fflush(stdout);
+    std::string reply;
+    if (request("RESULT " + lease + " " + std::to_string(data.size()) + "\n" +
+                    data,
+                reply) &&
+        strncmp(reply.c_str(), "OK", 2) != 0) {
+      fprintf(stderr, "worker: result of lease %s dropped: %s", lease.c_str(),
+              reply.c_str());
+    }
+    lease.clear();
+  }
+
+  // gives the running chunk back without a result, its output is only printed
+  void release_chunk() {
+    if (lease.empty()) {
+      return;
+    }
+    const std::string data = end_capture();
+    fwrite(data.data(), 1, data.size(), stdout);
+    fflush(stdout);
+    std::string reply;
+    request("RELEASE " + lease + "\n", reply);
+    lease.clear();
+  }
+
+  // reports that the running chunk can't be run, its output is only printed
+  void fail_chunk(const char *reason) {
+    if (lease.empty()) {
+      return;
+    }
+    const std::string data = end_capture();
+    fwrite(data.data(), 1, data.size(), stdout);
+    fflush(stdout);
+    std::string reply;
+    request("FAIL " + lease + " " + reason + "\n", reply);
+    lease.clear();
+  }
+};
+
+// the chunks of the arguments, with --worker the coordinator's, or with
+// --shard the ones the search's enumerate gives
+struct ChunkSource {
+  ChunkList list;
+  Worker worker;
+  Shard shard;
+  std::function<bool(ChunkArgs &)> enumerate;
+  size_t index = 0;
+
+  bool read(const int argc, char *argv[], const int first) {
+    if (!worker.enabled() && !shard.enabled()) {
+      return read_chunks(argc, argv, first, list);
+    }
+    if (worker.enabled() && shard.enabled()) {
+      printf("--worker and --shard can't be combined\n");
+      return false;
+    }
+    if (first < argc) {
+      printf("no chunks can be given with --worker or --shard\n");
+      return false;
+    }
+    list.wrapped = true;
+    return true;
+  }
+
+  // for a chunk the search can't run, a worker's coordinator mustn't take its
+  // output as the result
+  void reject(const char *reason) {
+    if (worker.enabled()) {
+      worker.fail_chunk(reason);
+    }
+  }
+
+  // a worker sends the output of the last chunk before it leases the next one
+  bool next(ChunkArgs &args) {
+    if (worker.enabled()) {
+      worker.finish_chunk();
+      if (!worker.lease_chunk(args)) {
+        return false;
+      }
+    } else if (shard.enabled()) {
+      if (!enumerate(args)) {
+        return false;
+      }
+    } else if (index < list.chunks.size()) {
+      args = list.chunks[index];
+    } else {
+      return false;
+    }
+    index++;
+    return true;
+  }
+
+  // the number of chunks, 0 with --worker or --shard, which only know the
+  // next one
+  size_t size() const {
+    return worker.enabled() || shard.enabled() ? 0 : list.chunks.size();
+  }
+};